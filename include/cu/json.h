@@ -4,52 +4,271 @@
 
 #include <cstdint>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
 namespace cu 
 {
+    class JsonString;
     class JsonValue;
+    class JsonArena;
+    struct JsonFragment;
+    typedef std::pair<JsonString, JsonValue> JsonMember;
     typedef std::vector<JsonValue> JsonArray;
-    typedef std::vector<std::pair<std::string, JsonValue>> JsonObject;
+    typedef std::vector<JsonMember> JsonObject;
     struct JsonParseError : std::runtime_error { JsonParseError(const std::string & what) : runtime_error("json parse error - " + what) {} };
 
-    JsonValue jsonFrom(const std::string & text); // throws JsonParseError
+    struct JsonParseOptions
+    {
+        bool borrow = false;            // If true, numbers, keys, and strings without escape sequences refer to the source text, which must outlive the result
+        JsonArena * arena = nullptr;    // If set, all remaining contents of the result are allocated from this arena, which must outlive the result
+        bool cacheNumbers = false;      // If true, the binary value of every number is parsed once and stored alongside its text, so that reading it costs nothing
+        bool packNumbers = false;       // If true, Arrays made up only of numbers hold them packed together as int64_t or double rather than as JsonValues, which
+                                        // rounds non-integers to double precision and prints them as formatJsonNumber does. Arrays made up only of floats decoded
+                                        // from CBOR are packed as floats. Ignored when using an arena.
+        bool shareSubtrees = false;     // If true, identical Arrays and Objects share one copy of their contents, found by the hashes which JsonValue::hash() memoizes,
+                                        // so that repeated blocks of a document cost memory only once. Ignored when using an arena.
+        size_t maxDepth = 512;          // Deepest nesting of arrays and objects accepted, beyond which parsing throws JsonParseError. Parsing itself does not recurse,
+                                        // but destroying, comparing, or decoding a JsonValue does, one level at a time.
+    };
+
+    JsonValue jsonFrom(const std::string & text, const JsonParseOptions & options = {}); // throws JsonParseError
+    JsonValue jsonFrom(const char * first, const char * last, const JsonParseOptions & options = {}); // throws JsonParseError
+    JsonValue jsonFrom(std::istream & in, const JsonParseOptions & options = {}); // Reads until the end of the stream, throws JsonParseError
+    void jsonFromStream(std::istream & in, const std::function<void(JsonValue)> & onValue, const JsonParseOptions & options = {}); // Parse each value of a stream of concatenated or newline delimited JSON as soon as it is complete, throws JsonParseError
+    JsonValue jsonFromFile(const std::string & path, const JsonParseOptions & options = {}, unsigned threads = 1); // Parses directly from a memory mapping of the file, so values cannot borrow from it, using jsonFromParallel if threads is not 1. Throws std::runtime_error if the file cannot be read.
+
+    // Parse a single large document using up to the given number of threads, or one per core if 0. A scan which matches quotes and brackets divides the elements
+    // and members of its outermost Arrays and Objects into chunks, which the other threads parse as soon as they are found, and which are joined in order once all
+    // are parsed. The result is the same as that of jsonFrom, except that keys, and subtrees shared by JsonParseOptions::shareSubtrees, are shared within each chunk
+    // rather than the whole document. Small documents and documents parsed into an arena are parsed on one thread. A malformed document is parsed again on one
+    // thread, to throw the same JsonParseError as jsonFrom.
+    JsonValue jsonFromParallel(const char * first, const char * last, const JsonParseOptions & options = {}, unsigned threads = 0);
+    JsonValue jsonFromParallel(const std::string & text, const JsonParseOptions & options = {}, unsigned threads = 0);
+
+    // Parse newline delimited JSON (one value per line, blank lines ignored) using up to the given number of threads, or one per core if 0. The text is divided between threads
+    // at newlines, which cannot occur inside JSON values. An arena is not thread safe, so setting one forces a single thread. Throws the JsonParseError of the earliest malformed line.
+    std::vector<JsonValue> jsonLinesFrom(const char * first, const char * last, const JsonParseOptions & options = {}, unsigned threads = 0); // Values in order of appearance
+    void jsonLinesFrom(const char * first, const char * last, const std::function<void(size_t line, JsonValue value)> & onValue, const JsonParseOptions & options = {}, unsigned threads = 0); // Calls onValue concurrently from several threads, in no particular order, with the zero-based line number of each value
+
+    // CBOR (RFC 8949) is a binary encoding of the same values, which is smaller and much faster to read than JSON text. Integers which fit in 64 bits are written
+    // exactly, floats in single precision, and all other numbers as doubles, so that as with JsonParseOptions::packNumbers, the text of numbers is not preserved.
+    std::vector<uint8_t> cborFrom(const JsonValue & val);
+    JsonValue jsonFromCbor(const uint8_t * first, const uint8_t * last, const JsonParseOptions & options = {}); // Borrowed strings refer to the CBOR data. Throws JsonParseError if the data is malformed, or holds byte strings or map keys other than text strings.
+    JsonValue jsonFromCbor(const std::vector<uint8_t> & data, const JsonParseOptions & options = {});
+
+    bool isJsonNumber(const char * first, const char * last);
     bool isJsonNumber(const std::string & num);
 
+    // Write the shortest JSON format number which reads back as exactly n into buffer, which must hold at least 32 characters, and return the end of the written text
+    char * formatJsonNumber(char * buffer, int64_t n);
+    char * formatJsonNumber(char * buffer, uint64_t n);
+    char * formatJsonNumber(char * buffer, float n);    // Infinities and NaNs, which JSON cannot represent, are written as null
+    char * formatJsonNumber(char * buffer, double n);
+
+    // Receives the contents of a JSON document as a sequence of events, without building any JsonValues. Default implementations ignore the event.
+    // String, key, and number ranges point either into the source text or into a temporary buffer, and are only valid for the duration of the call.
+    struct JsonHandler
+    {
+        virtual             ~JsonHandler()                                  {}
+        virtual void        onNull()                                        {}
+        virtual void        onBool(bool)                                    {}
+        virtual void        onNumber(const char *, const char *)            {} // Range holds a valid JSON format number
+        virtual void        onString(const char *, const char *)            {} // Range holds the decoded contents of the string
+        virtual void        onStartArray()                                  {}
+        virtual void        onEndArray()                                    {}
+        virtual void        onStartObject()                                 {}
+        virtual void        onKey(const char *, const char *)               {} // Range holds the decoded name of the field whose value follows
+        virtual void        onEndObject()                                   {}
+    };
+    void jsonParse(const std::string & text, JsonHandler & handler, const JsonParseOptions & options = {}); // Only options.maxDepth applies, throws JsonParseError
+
+    // Resumable parser for a sequence of top-level values, such as concatenated or newline delimited JSON, which accepts its input in chunks of any size.
+    // Only the input belonging to values which are not yet complete is buffered, so memory use is bounded by the largest value rather than the whole stream.
+    class JsonStream
+    {
+        enum State : uint8_t { Between, Nested, Quoted, Bare }; // Position of the scan relative to the current value
+        JsonParseOptions    options;
+        std::string         buffer;     // Input which has not yet been consumed
+        size_t              start;      // Start of the current value within buffer
+        size_t              scanned;    // How much of buffer has been scanned for the end of the current value
+        int                 depth;      // Number of arrays and objects open at scanned
+        State               state;
+        bool                finished;
+
+        bool                scan(size_t & end);                         // Find the end of the current value, if it has arrived
+    public:
+                            JsonStream(const JsonParseOptions & options = {}); // Values may not borrow from the input, which is discarded once parsed
+
+        void                feed(const char * first, const char * last); // Append a chunk of input
+        void                finish();                                   // Signal that no more input will arrive, completing any trailing number or literal
+        bool                next(JsonValue & value);                    // Parse the next complete value, if there is one. Throws JsonParseError if it is malformed, after which it is skipped.
+        bool                empty() const                               { return buffer.find_first_not_of(" \t\n\r", start) == std::string::npos; } // True if no unconsumed input remains
+    };
+
+    // Read-only view of a contiguous range of elements owned elsewhere
+    template<class T> struct array_ref
+    {
+        const T *           first, * last;
+
+        const T *           begin() const                               { return first; }
+        const T *           end() const                                 { return last; }
+        size_t              size() const                                { return last - first; }
+        bool                empty() const                               { return first == last; }
+        const T &           operator[](size_t index) const              { return first[index]; }
+    };
+
+    // Reference counted storage, which can be shared between any number of JsonStrings and JsonValues
+    struct JsonBlock { std::atomic<int> refs; JsonBlock() : refs(1) {} virtual ~JsonBlock() {} };
+    struct JsonStringBlock : JsonBlock { std::string str; JsonStringBlock(std::string str) : str(move(str)) {} };
+
+    // Monotonic allocator for parsed documents. Memory is only released when the arena is destroyed, all at once, and values allocated from it must not outlive it.
+    class JsonArena
+    {
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *              next, * limit;  // Unused portion of the most recent block
+        size_t              blockSize;      // Size of each new block
+        size_t              bytes;          // Total size of all blocks
+    public:
+                            JsonArena(size_t blockSize = 1 << 20)       : next(), limit(), blockSize(blockSize), bytes() {}
+                            JsonArena(const JsonArena &)                = delete;
+        JsonArena &         operator = (const JsonArena &)              = delete;
+
+        void *              allocate(size_t size, size_t alignment);
+        size_t              reserved() const                            { return bytes; } // Total size of all blocks allocated so far
+    };
+
+    // String contents which either share ownership of their characters with other strings and values, or borrow them from a buffer which is kept alive elsewhere
+    class JsonString
+    {
+        friend class JsonValue;
+        friend struct JsonBuilder;
+        const char *        first;
+        size_t              length;
+        JsonBlock *         owner;  // Storage holding the characters, or nullptr if they are borrowed
+
+                            JsonString(const char * first, size_t length, JsonBlock * owner) : first(first), length(length), owner(owner) { if (owner) ++owner->refs; }
+    public:
+                            JsonString()                                : JsonString("", 0, nullptr) {}                 // Default construct empty string
+                            JsonString(std::string s)                   : owner(new JsonStringBlock(move(s))) { first = static_cast<JsonStringBlock *>(owner)->str.data(); length = static_cast<JsonStringBlock *>(owner)->str.size(); } // Take ownership of std::string
+                            JsonString(const char * s)                  : JsonString(std::string(s)) {}                 // Copy C-string
+                            JsonString(const JsonString & r)            : JsonString(r.first, r.length, r.owner) {}
+                            JsonString(JsonString && r)                 : first(r.first), length(r.length), owner(r.owner) { r.first = ""; r.length = 0; r.owner = nullptr; }
+                            ~JsonString()                               { if (owner && --owner->refs == 0) delete owner; }
+        JsonString &        operator = (JsonString r)                   { std::swap(first, r.first); std::swap(length, r.length); std::swap(owner, r.owner); return *this; }
+
+        const char *        data() const                                { return first; }
+        size_t              size() const                                { return length; }
+        bool                empty() const                               { return length == 0; }
+        const char *        begin() const                               { return first; }
+        const char *        end() const                                 { return first + length; }
+        bool                borrowed() const                            { return !owner; }
+        std::string         str() const                                 { return std::string(first, length); }
+                            operator std::string () const               { return str(); }
+
+        static JsonString   borrow(const char * first, const char * last) { return JsonString(first, last - first, nullptr); } // Refer to characters which must outlive this string and all copies of it
+    };
+
+    inline bool operator == (const JsonString & a, const JsonString & b)   { return a.size() == b.size() && (a.data() == b.data() || memcmp(a.data(), b.data(), a.size()) == 0); }
+    inline bool operator == (const JsonString & a, const char * b)         { return strlen(b) == a.size() && memcmp(a.data(), b, a.size()) == 0; }
+    inline bool operator == (const JsonString & a, const std::string & b)  { return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0; }
+    inline bool operator != (const JsonString & a, const JsonString & b)   { return !(a == b); }
+    inline bool operator != (const JsonString & a, const char * b)         { return !(a == b); }
+    inline bool operator != (const JsonString & a, const std::string & b)  { return !(a == b); }
+    inline std::ostream & operator << (std::ostream & out, const JsonString & s) { return out.write(s.data(), s.size()); }
+
     class JsonValue
     {
-        template<class T> static std::string to_str(const T & val) { std::ostringstream ss; ss << val; return ss.str(); }
+        friend struct JsonBuilder;
+        friend struct CborEncoder;
+        friend class JsonReader;
+        friend class JsonWriter;
 
-        enum                Kind { Null, False, True, String, Number, Array, Object };
-        Kind                kind; // What kind of value is this?
-        std::string         str;  // Contents of String or Number value
-        JsonObject          obj;  // Fields of Object value
-        JsonArray           arr;  // Elements of Array value
+        enum                Kind : uint8_t { Null, False, True, String, Number, Array, Object };
+        enum                Cache : uint8_t { Uncached, Integer, Natural, Real, Single }; // Single values are floats, held exactly in real
+        Kind                kind;   // What kind of value is this?
+        Cache               cached; // Which member of the union below holds the binary value of a Number, if any, or whether a packed Array holds Integers, Reals or Singles
+        uint32_t            digits; // Number of characters of a Number, or 0 if it holds only a binary value, which is formatted on demand
+        JsonBlock *         owner;  // Storage holding the contents of this value, or nullptr if they are borrowed, allocated from a JsonArena, or absent
+        const void *        data;   // Characters of a String or Number, elements of an Array, or members of an Object
+        union
+        {
+            size_t          size;   // Number of characters of a String, elements of an Array, or members of an Object
+            int64_t         integer;
+            uint64_t        natural;
+            double          real;
+        };
 
-                            JsonValue(Kind kind, std::string str)       : kind(kind), str(move(str)) {}
+                            JsonValue(Kind kind, JsonBlock * owner, const void * data, size_t size) : kind(kind), cached(Uncached), digits(kind == Number ? static_cast<uint32_t>(size) : 0), owner(owner), data(data), size(size) {} // Adopts a reference to owner
+                            JsonValue(Kind kind, JsonString str)        : JsonValue(kind, str.owner, str.first, str.length) { str.owner = nullptr; }
+        template<class T> array_ref<T> elements(Kind k) const           { auto first = static_cast<const T *>(kind == k ? data : nullptr); return{ first, first + (first ? size : 0) }; }
+        const char *        chars() const                               { return static_cast<const char *>(data); }
+        template<class T> array_ref<T> packed(Cache c) const            { return cached == c ? elements<T>(Array) : array_ref<T>{ nullptr, nullptr }; }
+        array_ref<JsonValue> unpack() const;                            // JsonValues for the elements of a packed Array, created on first use
+        JsonValue           packedElement(size_t index) const           { return cached == Integer ? JsonValue(packedIntegers()[index]) : cached == Real ? JsonValue(packedReals()[index]) : cached == Single ? JsonValue(packedFloats()[index]) : elements<JsonValue>(Array)[index]; } // Element of an Array, without unpacking it
+        std::atomic<size_t> * memo() const;                             // Where the hash of an Array or Object with a block of its own is memoized, or nullptr
+        std::atomic<JsonFragment *> * fragment() const;                 // Where the text of an Array or Object with a block of its own is cached, or nullptr
+        const JsonMember *  find(const char * key, size_t length) const;    // First member with the given name, or nullptr if there is none
+        const JsonValue &   member(const char * key, size_t length) const;  // Value of the first member with the given name, or null if there is none
+        JsonArray &         ownElements();                              // Make this an Array whose elements no other value shares, and return them
+        JsonObject &        ownMembers();                               // Make this an Object whose members no other value shares, and return them
+        void                resized(bool appended = false);             // Point at the elements or members of our own block after adding or removing some
+        JsonValue &         slot(size_t index);                         // Element at index, grown as needed, of an Array whose elements no other value shares
+        JsonValue &         slot(const char * key, size_t length, const JsonString * name); // Value of the named member, appended as null if there is none, likewise
+        JsonValue &         lend(JsonValue & val);                      // Stop memoizing this Array or Object, as val, one of its elements or members, may change unseen
+        void                retain();                                   // Take a reference to the contents of the value this was copied from, or copies of them if they are lent
+        bool                erase(const char * key, size_t length);
+        JsonValue           takeMember(const char * key, size_t length);
+        void                cacheNumber();                              // Parse the text of a Number and store its binary value
+        array_ref<char>     numberText(char * buffer) const;            // Text of a Number, formatted into buffer if it holds only a binary value
+
+        bool                numberAs(int64_t & n) const;                // Locale-independent conversions of a Number, which fail if the value is out of range
+        bool                numberAs(uint64_t & n) const;               // Integer conversions truncate any fractional part
+        bool                numberAs(double & n) const;                 // Floating point conversions are correctly rounded, except that a float read from a
+        bool                numberAs(float & n) const;                  // cached double is rounded twice
+        template<class T> typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, bool>::type numberAs(T & n) const { int64_t i; if (!numberAs(i) || i < std::numeric_limits<T>::min() || i > std::numeric_limits<T>::max()) return false; n = static_cast<T>(i); return true; }
+        template<class T> typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, bool>::type numberAs(T & n) const { uint64_t u; if (!numberAs(u) || u > std::numeric_limits<T>::max()) return false; n = static_cast<T>(u); return true; }
+        template<class T> typename std::enable_if<std::is_floating_point<T>::value, bool>::type numberAs(T & n) const { double d; if (!numberAs(d)) return false; n = static_cast<T>(d); return true; }
+        template<class T> typename std::enable_if<!std::is_arithmetic<T>::value, bool>::type numberAs(T & n) const { return !!(std::istringstream(contents().str()) >> n); }
     public:
-                            JsonValue()                                 : kind(Null) {}                 // Default construct null
-                            JsonValue(std::nullptr_t)                   : kind(Null) {}                 // Construct null from nullptr
-                            JsonValue(bool b)                           : kind(b ? True : False) {}     // Construct true or false from boolean
+                            JsonValue()                                 : JsonValue(Null, nullptr, nullptr, 0) {}       // Default construct null
+                            JsonValue(std::nullptr_t)                   : JsonValue() {}                                // Construct null from nullptr
+                            JsonValue(bool b)                           : JsonValue(b ? True : False, nullptr, nullptr, 0) {} // Construct true or false from boolean
                             JsonValue(const char * s)                   : JsonValue(String, s) {}           // Construct String from C-string
                             JsonValue(std::string s)                    : JsonValue(String, move(s)) {}     // Construct String from std::string
-                            JsonValue(int32_t n)                        : JsonValue(Number, to_str(n)) {}   // Construct Number from integer
-                            JsonValue(uint32_t n)                       : JsonValue(Number, to_str(n)) {}   // Construct Number from integer
-                            JsonValue(int64_t n)                        : JsonValue(Number, to_str(n)) {}   // Construct Number from integer
-                            JsonValue(uint64_t n)                       : JsonValue(Number, to_str(n)) {}   // Construct Number from integer
-                            JsonValue(float n)                          : JsonValue(Number, to_str(n)) {}   // Construct Number from float
-                            JsonValue(double n)                         : JsonValue(Number, to_str(n)) {}   // Construct Number from double
-                            JsonValue(JsonObject o)                     : kind(Object), obj(move(o)) {} // Construct Object from vector<pair<string,JsonValue>> (TODO: Assert no duplicate keys)
-                            JsonValue(JsonArray a)                      : kind(Array), arr(move(a)) {}  // Construct Array from vector<JsonValue>
-
-        bool                operator == (const JsonValue & r) const     { return kind == r.kind && str == r.str && obj == r.obj && arr == r.arr; }
+                            JsonValue(JsonString s)                     : JsonValue(String, std::move(s)) {} // Construct String from JsonString, sharing or borrowing its characters
+                            JsonValue(int32_t n)                        : JsonValue(static_cast<int64_t>(n)) {}         // Construct Number from integer
+                            JsonValue(uint32_t n)                       : JsonValue(static_cast<uint64_t>(n)) {}        // Construct Number from integer
+                            JsonValue(int64_t n)                        : JsonValue(Number, nullptr, nullptr, 0) { cached = Integer; integer = n; }   // Construct Number from integer
+                            JsonValue(uint64_t n)                       : JsonValue(Number, nullptr, nullptr, 0) { cached = Natural; natural = n; }   // Construct Number from integer
+                            JsonValue(float n)                          : JsonValue(std::isfinite(n) ? Number : Null, nullptr, nullptr, 0) { if (isNumber()) cached = Single, real = n; } // Construct Number from float, or null if n is not finite
+                            JsonValue(double n)                         : JsonValue(std::isfinite(n) ? Number : Null, nullptr, nullptr, 0) { if (isNumber()) cached = Real, real = n; }   // Construct Number from double, or null if n is not finite
+                            JsonValue(JsonObject o);                                                        // Construct Object from vector<pair<JsonString,JsonValue>> (TODO: Assert no duplicate keys)
+                            JsonValue(JsonArray a);                                                         // Construct Array from vector<JsonValue>
+                            JsonValue(const JsonValue & r)              : kind(r.kind), cached(r.cached), digits(r.digits), owner(r.owner), data(r.data), natural(r.natural) { if (owner) retain(); } // Copies share the contents of r
+                            JsonValue(JsonValue && r)                   : kind(r.kind), cached(r.cached), digits(r.digits), owner(r.owner), data(r.data), natural(r.natural) { r.kind = Null; r.cached = Uncached; r.owner = nullptr; }
+                            ~JsonValue()                                { if (owner && --owner->refs == 0) delete owner; }
+        JsonValue &         operator = (JsonValue r)                    { std::swap(kind, r.kind); std::swap(cached, r.cached); std::swap(digits, r.digits); std::swap(owner, r.owner); std::swap(data, r.data); std::swap(natural, r.natural); return *this; }
+
+        bool                operator == (const JsonValue & r) const;
         bool                operator != (const JsonValue & r) const     { return !(*this == r); }
+        size_t              hash() const;                               // Structural hash, equal for equal values. Memoized for Arrays and Objects which have a block of their own, unless
+                                                                        // it has lent references through edit(), so that it costs one step per element once their elements are hashed,
+                                                                        // and comparing such values whose hashes are known fails at once if they differ. Values which share their
+                                                                        // contents compare equal at once.
 
-        const JsonValue &   operator[](size_t index) const              { const static JsonValue null; return index < arr.size() ? arr[index] : null; }
+        const JsonValue &   operator[](size_t index) const              { const static JsonValue null; auto arr = array(); return index < arr.size() ? arr[index] : null; }
         const JsonValue &   operator[](int index) const                 { const static JsonValue null; return index < 0 ? null : (*this)[static_cast<size_t>(index)]; }
-        const JsonValue &   operator[](const char * key) const          { for (auto & kvp : obj) if (kvp.first == key) return kvp.second; const static JsonValue null; return null; }
-        const JsonValue &   operator[](const std::string & key) const   { return (*this)[key.c_str()]; }
+        const JsonValue &   operator[](const char * key) const          { return member(key, strlen(key)); }
+        const JsonValue &   operator[](const std::string & key) const   { return member(key.data(), key.size()); }
+        const JsonValue &   operator[](const JsonString & key) const    { return member(key.data(), key.size()); } // Keys copied by the parser are shared within each document, so a key taken from one of its Objects finds members of the others by address
 
         bool                isString() const                            { return kind == String; }
         bool                isNumber() const                            { return kind == Number; }
@@ -60,28 +279,319 @@ namespace cu
         bool                isNull() const                              { return kind == Null; }
 
         bool                boolOrDefault(bool def) const               { return isTrue() ? true : isFalse() ? false : def; }
-        std::string         stringOrDefault(const char * def) const     { return kind == String ? str : def; }
-        template<class T> T numberOrDefault(T def) const                { if (!isNumber()) return def; T val = def; std::istringstream(str) >> val; return val; }
+        std::string         stringOrDefault(const char * def) const     { return kind == String ? std::string(chars(), size) : def; }
+        template<class T> T numberOrDefault(T def) const                { T val; return isNumber() && numberAs(val) ? val : def; }
 
         std::string         string() const                              { return stringOrDefault(""); } // Value, if a String, empty otherwise
         template<class T> T number() const                              { return numberOrDefault(T()); } // Value, if a Number, empty otherwise
-        const JsonObject &  object() const                              { return obj; }    // Name/value pairs, if an Object, empty otherwise
-        const JsonArray &   array() const                               { return arr; }    // Values, if an Array, empty otherwise
+        array_ref<JsonMember> object() const                            { return elements<JsonMember>(Object); } // Name/value pairs, if an Object, empty otherwise
+        array_ref<JsonValue> array() const                              { return kind == Array && cached ? unpack() : elements<JsonValue>(Array); } // Values, if an Array, empty otherwise
+        array_ref<int64_t>  packedIntegers() const                      { return packed<int64_t>(Integer); }    // Elements, if a packed Array of integers, empty otherwise
+        array_ref<double>   packedReals() const                         { return packed<double>(Real); }        // Elements, if a packed Array of other numbers, empty otherwise
+        array_ref<float>    packedFloats() const                        { return packed<float>(Single); }       // Elements, if a packed Array of floats, empty otherwise
+
+        JsonString          contents() const;                           // Contents, if a String, JSON format number, if a Number, empty otherwise
 
-        const std::string & contents() const                            { return str; }    // Contents, if a String, JSON format number, if a Number, empty otherwise
+        // Move out the contents of a value, leaving it null. Storage which no other value shares is moved rather than copied: the characters of long strings,
+        // and the elements or members of Arrays and Objects, which are themselves shared with the original rather than copied if they are not moved.
+        std::string         takeString();                               // Value, if a String, empty otherwise
+        JsonArray           takeArray();                                // Elements, if an Array, empty otherwise
+        JsonObject          takeObject();                               // Name/value pairs, if an Object, empty otherwise
+        JsonValue           takeMember(const char * key)                { return takeMember(key, strlen(key)); } // Value of the first member with the given name, found as by operator[],
+        JsonValue           takeMember(const std::string & key)         { return takeMember(key.data(), key.size()); } // leaving null in its place, or null if there is none
 
-        static JsonValue    fromNumber(std::string num)                 { assert(cu::isJsonNumber(num)); return JsonValue(Number, move(num)); }
+        // Edit a value in place. Copies of a value share its contents, so an Array or Object which is shared, or whose contents are borrowed, packed, or allocated
+        // from a JsonArena, is first given elements or members of its own. These share their values with the original, so an edit at any depth copies only the
+        // containers on the way to it, and never affects other copies. References returned by edit() and push() are invalidated by the next edit of the same
+        // container. They can change it unseen, so a container which has returned any is no longer memoized by hash() or cached by a JsonWriter, unlike those
+        // changed only by set() and erase(), and is copied one level deep rather than shared by copies of it made afterwards.
+        JsonValue &         edit(size_t index)                          { return lend(slot(index)); } // Element at index, growing the Array with nulls if needed. Non-Arrays are replaced by an empty Array first.
+        JsonValue &         edit(int index)                             { assert(index >= 0); return edit(static_cast<size_t>(index)); }
+        JsonValue &         edit(const char * key)                      { return lend(slot(key, strlen(key), nullptr)); } // Value of the first member with the given name, appending a null member
+        JsonValue &         edit(const std::string & key)               { return lend(slot(key.data(), key.size(), nullptr)); } // if there is none. Non-Objects are replaced by an empty Object first.
+        JsonValue &         edit(const JsonString & key)                { return lend(slot(key.data(), key.size(), &key)); } // An appended member shares the characters of key
+        void                set(size_t index, JsonValue value)          { slot(index) = std::move(value); } // Set the value of an element or member, as above
+        void                set(int index, JsonValue value)             { assert(index >= 0); slot(static_cast<size_t>(index)) = std::move(value); }
+        void                set(const char * key, JsonValue value)      { slot(key, strlen(key), nullptr) = std::move(value); }
+        void                set(const std::string & key, JsonValue value) { slot(key.data(), key.size(), nullptr) = std::move(value); }
+        void                set(const JsonString & key, JsonValue value) { slot(key.data(), key.size(), &key) = std::move(value); }
+        JsonValue &         push(JsonValue value);                      // Append an element, replacing non-Arrays by an empty Array first, and return it
+        bool                erase(size_t index);                        // Remove an element, returning false if there is none at index or this is not an Array
+        bool                erase(int index)                            { return index >= 0 && erase(static_cast<size_t>(index)); }
+        bool                erase(const char * key)                     { return erase(key, strlen(key)); } // Remove the first member with the given name, returning
+        bool                erase(const std::string & key)              { return erase(key.data(), key.size()); } // false if there is none or this is not an Object
+
+        static JsonValue    fromNumber(JsonString num)                  { assert(cu::isJsonNumber(num.begin(), num.end())); return JsonValue(Number, std::move(num)); }
     };
 
+    // Text of an Array or Object, as written by a JsonWriter which caches fragments, along with the format it was written in
+    struct JsonFragment { std::string text; int tabWidth, indent; }; // Both 0 and -1 if written compactly
+
+    // Shared storage for the contents of Arrays and Objects which were not allocated from a JsonArena, and for the elements of packed Arrays
+    struct JsonArrayBlock : JsonBlock
+    {
+        JsonArray elements;
+        std::atomic<size_t> hash;       // JsonValue::hash() of the Array, or 0 if not yet known
+        std::atomic<JsonFragment *> text; // Text of the Array, if it has been cached
+        bool lent;                      // Whether edit() has returned references to elements, through which they may change unseen, so that neither is kept
+
+        JsonArrayBlock(JsonArray elements) : elements(move(elements)), hash(), text(), lent() {}
+        ~JsonArrayBlock() { delete text.load(); }
+    };
+    struct JsonObjectBlock : JsonBlock
+    {
+        JsonObject members;
+        std::atomic<uint32_t *> index; // Open addressing hash table of member positions plus one, built by the first keyed lookup into a wide object
+        std::atomic<size_t> hash;       // JsonValue::hash() of the Object, or 0 if not yet known
+        std::atomic<JsonFragment *> text; // Text of the Object, if it has been cached
+        bool lent;                      // Whether edit() has returned references to members, likewise
+
+        JsonObjectBlock(JsonObject members) : members(move(members)), index(), hash(), text(), lent() {}
+        ~JsonObjectBlock() { delete[] index.load(); delete text.load(); }
+    };
+    struct JsonNumbersBlock : JsonBlock
+    {
+        std::vector<int64_t> integers;      // Elements of packed Arrays of integers, of other numbers, or of floats. Only one of these is
+        std::vector<double> reals;          // used by each block, and it is never grown beyond its initial capacity, as the Arrays point into it
+        std::vector<float> floats;
+        std::atomic<JsonValue *> values;    // JsonValues for the integers, reals and floats in turn, created by the first call to array() on any Array stored here
+
+        template<class T> JsonNumbersBlock(std::vector<T> JsonNumbersBlock::* slots, size_t capacity) : values() { (this->*slots).reserve(capacity); }
+        ~JsonNumbersBlock() { delete[] values.load(); }
+    };
+    inline JsonValue::JsonValue(JsonObject o) : JsonValue(Object, new JsonObjectBlock(move(o)), nullptr, 0) { auto & m = static_cast<JsonObjectBlock *>(owner)->members; data = m.data(); size = m.size(); }
+    inline JsonValue::JsonValue(JsonArray a) : JsonValue(Array, new JsonArrayBlock(move(a)), nullptr, 0) { auto & e = static_cast<JsonArrayBlock *>(owner)->elements; data = e.data(); size = e.size(); }
+
     std::ostream & operator << (std::ostream & out, const JsonValue & val);
-    std::ostream & operator << (std::ostream & out, const JsonArray & arr);
-    std::ostream & operator << (std::ostream & out, const JsonObject & obj);
+    std::ostream & operator << (std::ostream & out, array_ref<JsonValue> arr);
+    std::ostream & operator << (std::ostream & out, array_ref<JsonMember> obj);
+    inline std::ostream & operator << (std::ostream & out, const JsonArray & arr) { return out << array_ref<JsonValue>{ arr.data(), arr.data() + arr.size() }; }
+    inline std::ostream & operator << (std::ostream & out, const JsonObject & obj) { return out << array_ref<JsonMember>{ obj.data(), obj.data() + obj.size() }; }
 
     template<class T> struct tabbed_ref { const T & value; int tabWidth, indent; };
     template<class T> tabbed_ref<T> tabbed(const T & value, int tabWidth, int indent = 0) { return{ value, tabWidth, indent }; }
     std::ostream & operator << (std::ostream & out, tabbed_ref<JsonValue> val);
-    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonArray> arr);
-    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonObject> obj);
+    std::ostream & operator << (std::ostream & out, tabbed_ref<array_ref<JsonValue>> arr);
+    std::ostream & operator << (std::ostream & out, tabbed_ref<array_ref<JsonMember>> obj);
+    inline std::ostream & operator << (std::ostream & out, tabbed_ref<JsonArray> arr) { return out << tabbed(array_ref<JsonValue>{ arr.value.data(), arr.value.data() + arr.value.size() }, arr.tabWidth, arr.indent); }
+    inline std::ostream & operator << (std::ostream & out, tabbed_ref<JsonObject> obj) { return out << tabbed(array_ref<JsonMember>{ obj.value.data(), obj.value.data() + obj.value.size() }, obj.tabWidth, obj.indent); }
+
+    // Pull parser which reads a JSON document one value at a time, for decoding it directly into C++ objects without building any JsonValues.
+    // Strings, keys and numbers are borrowed from the source text or from an internal buffer, and are only valid until the next call.
+    class JsonReader
+    {
+    protected:
+        const char *        it, * last;
+        std::string         buffer;                                     // Decoded contents of the most recent string literal which contained escape sequences
+
+        void                skipWhitespace();
+        bool                matchAndDiscard(char ch);
+        void                discardExpected(char ch, const char * what);
+        JsonString          parseString();                              // Assumes the opening quote has already been consumed
+        JsonString          parseNumber();
+    public:
+        enum Kind           { Null, False, True, String, Number, Array, Object };
+
+                            JsonReader(const char * first, const char * last) : it(first), last(last) {}
+
+        Kind                peek();                                     // Kind of the next value, throws JsonParseError if there is no valid value
+        void                skip();                                     // Discard the next value, after checking that it is well formed
+        JsonValue           readValue(const JsonParseOptions & options = {}); // Parse the next value whole
+        bool                readBool()                                  { auto k = peek(); if (k != True && k != False) throw JsonParseError("Expected true or false"); it += k == True ? 4 : 5; return k == True; }
+        JsonValue           readNumber()                                { if (peek() != Number) throw JsonParseError("Expected number"); return JsonValue(JsonValue::Number, parseNumber()); } // Borrows its text
+        JsonString          readString()                                { if (peek() != String) throw JsonParseError("Expected string"); ++it; return parseString(); }
+        bool                readStartArray()                            { if (peek() != Array) throw JsonParseError("Expected array"); ++it; return !matchAndDiscard(']'); } // False if the array is empty
+        bool                readNextElement()                           { if (matchAndDiscard(']')) return false; discardExpected(',', ", or ]"); return true; } // After each element, false at the end of the array
+        bool                readStartObject()                           { if (peek() != Object) throw JsonParseError("Expected object"); ++it; return !matchAndDiscard('}'); } // False if the object is empty
+        JsonString          readKey()                                   { discardExpected('"', "string"); auto key = parseString(); discardExpected(':', ":"); return key; } // Name of the member whose value follows
+        bool                readNextMember()                            { if (matchAndDiscard('}')) return false; discardExpected(',', ", or }"); return true; } // After each member, false at the end of the object
+        void                readEnd()                                   { skipWhitespace(); if (it != last) throw JsonParseError("Syntax error: Expected end-of-stream"); }
+    };
+
+    // Value within a JsonDocument, whose text has been located but is only parsed on demand. The first call to operator[], array() or object() on an Array or
+    // Object finds the bounds of its elements or members by matching quotes and brackets, without parsing them, and the first call to value() parses it into
+    // a JsonValue. Both results are cached, and may be created by several threads at once. Text which is never navigated to is never checked.
+    class JsonDocument;
+    struct JsonLazyIndex;
+    class JsonLazyValue
+    {
+        friend class JsonDocument;
+        const JsonDocument *                doc;
+        const char *                        first, * last;  // Text of the value, without surrounding whitespace
+        mutable std::atomic<JsonLazyIndex *> index;         // Elements or members, found by the first call to indexed()
+        mutable std::atomic<JsonValue *>    parsed;         // Value, parsed by the first call to value()
+
+        const JsonLazyIndex &               indexed() const;
+    public:
+                                            JsonLazyValue(const JsonDocument * doc, const char * first, const char * last) : doc(doc), first(first), last(last), index(), parsed() {}
+                                            JsonLazyValue(JsonLazyValue && r) : doc(r.doc), first(r.first), last(r.last), index(r.index.exchange(nullptr)), parsed(r.parsed.exchange(nullptr)) {}
+                                            JsonLazyValue(const JsonLazyValue &) = delete;
+                                            ~JsonLazyValue();
+
+        const JsonLazyValue &               operator[](size_t index) const;
+        const JsonLazyValue &               operator[](int index) const                 { return (*this)[index < 0 ? array().size() : static_cast<size_t>(index)]; }
+        const JsonLazyValue &               operator[](const char * key) const          { return member(key, strlen(key)); }
+        const JsonLazyValue &               operator[](const std::string & key) const   { return member(key.data(), key.size()); }
+        const JsonLazyValue &               member(const char * key, size_t length) const; // Value of the first member with the given name, or null if there is none
+
+        bool                                isString() const                            { return *first == '"'; } // Kinds are told from the first character alone
+        bool                                isNumber() const                            { return *first == '-' || (*first >= '0' && *first <= '9'); }
+        bool                                isObject() const                            { return *first == '{'; }
+        bool                                isArray() const                             { return *first == '['; }
+        bool                                isTrue() const                              { return *first == 't'; }
+        bool                                isFalse() const                             { return *first == 'f'; }
+        bool                                isNull() const                              { return *first == 'n'; }
+
+        array_ref<char>                     text() const                                { return{ first, last }; } // Unparsed text of the value
+        array_ref<JsonLazyValue>            array() const;                              // Elements, if an Array, empty otherwise
+        array_ref<std::pair<JsonString, JsonLazyValue>> object() const;                 // Name/value pairs, if an Object, empty otherwise
+        const JsonValue &                   value() const;                              // Parsed with the options of the document, throws JsonParseError
+    };
+    typedef std::pair<JsonString, JsonLazyValue> JsonLazyMember;
+    struct JsonLazyIndex { std::vector<JsonLazyValue> elements; std::vector<JsonLazyMember> members; std::vector<uint32_t> slots; }; // Slots hold member positions plus one, hashed by name as in JsonObjectBlock, for wide objects
+
+    // Text of a single JSON value, navigated without parsing any more of it than is needed, for reading a few values out of a large document. Construction
+    // only trims whitespace, so errors are reported by whichever call first parses or indexes the malformed part.
+    class JsonDocument
+    {
+        friend class JsonLazyValue;
+        std::string                         owned;
+        JsonParseOptions                    options;
+        JsonLazyValue                       root;
+    public:
+                                            JsonDocument(std::string text, const JsonParseOptions & options = {}); // Keeps the text, throws JsonParseError if it is blank
+                                            JsonDocument(const char * first, const char * last, const JsonParseOptions & options = {}); // Borrows text which must outlive the document
+                                            JsonDocument(const JsonDocument &)          = delete;
+
+        const JsonLazyValue &               operator*() const                           { return root; }
+        const JsonLazyValue *               operator->() const                          { return &root; }
+        template<class K> const JsonLazyValue & operator[](const K & key) const         { return root[key]; }
+    };
+
+    // Set of paths, compiled once, whose values are extracted from documents as they are parsed. Only matching values are built into JsonValues, and text which
+    // no path leads into is skipped by matching quotes and brackets, without being checked or decoded. Paths are JSON Pointers, such as "/objects/0/name", in
+    // which a segment of "*" matches every member of an object and every element of an array, as in "/objects/*/pose/position". "" matches the whole document.
+    class JsonQuery
+    {
+        friend struct JsonQueryRunner;
+        struct State
+        {
+            std::vector<std::pair<std::string, size_t>> members;    // Next state after members with each name given by some path
+            std::vector<std::pair<size_t, size_t>> elements;        // Next state after array elements with each index given by some path
+            size_t other;                                           // Next state after any other member or element
+            std::vector<size_t> matches;                            // Paths which end here
+        };
+        std::vector<State>  states;                                 // Deterministic automaton over the keys and indices leading to a value, where 0 matches nothing further and 1 is the start
+        size_t              count;
+
+        size_t              next(size_t state, const char * key, size_t length) const;
+        size_t              next(size_t state, size_t index) const;
+        void                match(size_t state, const JsonValue & val, const std::function<void(size_t path, const JsonValue & val)> & onMatch) const;
+    public:
+        explicit            JsonQuery(const std::vector<std::string> & paths); // Throws std::invalid_argument if a path is not "" and does not start with '/'
+
+        size_t              size() const                                { return count; }
+
+        void                evaluate(const char * first, const char * last, const std::function<void(size_t path, const JsonValue & val)> & onMatch, const JsonParseOptions & options = {}) const; // Report each value matching a path, in document order, throws JsonParseError
+        std::vector<JsonArray> evaluate(const std::string & text, const JsonParseOptions & options = {}) const; // Values matching each path, in document order, throws JsonParseError
+    };
+
+    // Serializes JSON text into a growable buffer, which is either kept in memory or handed to a sink whenever it fills up. The ostream operators above are thin wrappers around this class.
+    class JsonWriter
+    {
+    public:
+        typedef std::function<void(const char * first, const char * last)> Sink;
+    private:
+        std::unique_ptr<char[]> buffer;
+        char *              next, * limit;                              // Unused part of buffer
+        Sink                sink;
+        size_t              flushed;                                    // Number of characters passed to the sink or discarded so far
+        size_t              minCached, maxCached;                       // Lengths of text of Arrays and Objects which are cached, or both 0 if none are
+        int                 depth;                                      // Number of arrays and objects started but not yet ended
+        bool                comma;                                      // Whether a ',' must be written before the next value or key
+        struct Frame { const JsonValue * value, * lastValue; const JsonMember * member, * lastMember; int indent; const JsonValue * container; size_t start; }; // Unwritten elements of an Array or members of an Object,
+                                                                        // its indent, and the container itself, whose text began after start characters
+        std::vector<Frame>  stack;                                      // Arrays and objects being written by putTree(...), innermost last
+
+        void                makeRoom(size_t n);                         // Flush to the sink, or grow the buffer, until n more characters fit
+        char *              reserve(size_t n)                           { if (static_cast<size_t>(limit - next) < n) makeRoom(n); return next; }
+        void                put(char ch)                                { *reserve(1) = ch; ++next; }
+        void                put(const char * first, const char * last)  { memcpy(reserve(last - first), first, last - first); next += last - first; }
+        void                putIndent(int space, int n = 0);
+        void                putString(const char * first, const char * last);
+        void                putLine(const JsonValue & val);             // Write a value which fits on one line: a scalar, packed Array, empty Object, or Array of scalars
+        void                putTree(const JsonValue & val, int tabWidth, int indent); // Write any value, compactly if indent < 0, using stack rather than recursion
+        void                putNumbers(const JsonValue & arr);          // Elements of a packed Array, without creating JsonValues for them
+        bool                putCached(const JsonValue & val, int tabWidth, int indent); // Write the cached text of val if it has some in this format, returning whether it did
+        void                cache(const JsonValue & val, size_t start, int tabWidth, int indent); // Cache the text of val, written after start characters, if it is still buffered
+        void                separate()                                  { if (comma) put(','); comma = depth != 0; }
+        void                start(char ch)                              { separate(); put(ch); ++depth; comma = false; }
+        void                end(char ch)                                { put(ch); comma = --depth != 0; }
+    public:
+                            JsonWriter()                                : next(), limit(), flushed(), minCached(), maxCached(), depth(), comma() {} // Keep all output in memory
+                            JsonWriter(Sink sink, size_t capacity = 1 << 16) : buffer(new char[capacity]), next(buffer.get()), limit(next + capacity), sink(std::move(sink)), flushed(), minCached(), maxCached(), depth(), comma() {} // Pass output to sink in chunks of up to capacity characters
+                            JsonWriter(const JsonWriter &)              = delete;
+                            ~JsonWriter()                               { if (sink) flush(); }
+
+        const char *        data() const                                { return buffer.get(); }                        // Output which has not yet been flushed
+        size_t              size() const                                { return next - buffer.get(); }
+        std::string         str() const                                 { return std::string(data(), size()); }
+        void                flush()                                     { if (sink && size()) sink(data(), next); flushed += size(); next = buffer.get(); } // Pass any buffered output to the sink, or discard it if there is none
+        void                clear()                                     { flushed += size(); next = buffer.get(); depth = 0; comma = false; stack.clear(); } // Discard any buffered output, along with any unfinished arrays and objects
+
+        // Keep the text written for each Array or Object whose contents have a block of their own, and whose text is between minLength and maxLength characters
+        // long, in that block, and copy it from there whenever the same contents are written in the same format again, until they are edited. Writing a large,
+        // mostly unchanged tree then formats only what has changed since it was last written. Text is only cached in the first format it is written in, and
+        // not if a sink has been passed part of it, nor for containers which have lent references through JsonValue::edit(). Caching is off until this is
+        // called, and a maxLength of 0 turns it off again.
+        void                cacheFragments(size_t minLength = 64, size_t maxLength = 1 << 16) { minCached = minLength; maxCached = maxLength; }
+
+        // Write whole values. Inside arrays and objects started below, values are separated by commas automatically
+        void                writeString(const char * first, const char * last) { separate(); putString(first, last); } // Write a quoted string, escaping ", \, and control characters
+        void                write(const JsonString & str)               { writeString(str.begin(), str.end()); }
+        void                write(const JsonValue & val)                { separate(); putTree(val, 0, -1); }
+        void                write(array_ref<JsonValue> arr)             { separate(); putTree(JsonValue(JsonValue::Array, nullptr, arr.begin(), arr.size()), 0, -1); }
+        void                write(array_ref<JsonMember> obj)            { separate(); putTree(JsonValue(JsonValue::Object, nullptr, obj.begin(), obj.size()), 0, -1); }
+        void                write(tabbed_ref<JsonValue> val)            { separate(); putTree(val.value, val.tabWidth, val.indent); }
+        void                write(tabbed_ref<array_ref<JsonValue>> arr) { separate(); putTree(JsonValue(JsonValue::Array, nullptr, arr.value.begin(), arr.value.size()), arr.tabWidth, arr.indent); }
+        void                write(tabbed_ref<array_ref<JsonMember>> obj){ separate(); putTree(JsonValue(JsonValue::Object, nullptr, obj.value.begin(), obj.value.size()), obj.tabWidth, obj.indent); }
+        void                writeNull()                                 { separate(); put("null", "null" + 4); }
+        void                writeBool(bool b)                           { separate(); if (b) put("true", "true" + 4); else put("false", "false" + 5); }
+        void                writeNumber(int64_t n)                      { separate(); next = formatJsonNumber(reserve(32), n); }
+        void                writeNumber(uint64_t n)                     { separate(); next = formatJsonNumber(reserve(32), n); }
+        void                writeNumber(float n)                        { separate(); next = formatJsonNumber(reserve(32), n); } // Infinities and NaNs are written as null
+        void                writeNumber(double n)                       { separate(); next = formatJsonNumber(reserve(32), n); }
+
+        // Write arrays and objects incrementally, without building JsonValues. Each member is a writeKey(...) followed by a value
+        void                writeStartArray()                           { start('['); }
+        void                writeEndArray()                             { end(']'); }
+        void                writeStartObject()                          { start('{'); }
+        void                writeEndObject()                            { end('}'); }
+        void                writeKey(const char * first, const char * last) { separate(); putString(first, last); put(':'); comma = false; }
+        void                writeKey(const char * name)                 { writeKey(name, name + strlen(name)); }
+    };
+
+    // Serializes CBOR, with the same interface as JsonWriter for writing values incrementally, and the same output as cborFrom(...) for whole values.
+    // Incrementally written arrays and objects have indefinite length, as their sizes are not known until they end.
+    struct CborWriter
+    {
+        std::vector<uint8_t> bytes;
+
+        void                write(const JsonValue & val);
+        void                writeString(const char * first, const char * last);
+        void                writeNull()                                 { bytes.push_back(0xF6); }
+        void                writeBool(bool b)                           { bytes.push_back(b ? 0xF5 : 0xF4); }
+        void                writeNumber(int64_t n);
+        void                writeNumber(uint64_t n);
+        void                writeNumber(float n);                       // Infinities and NaNs are written as null
+        void                writeNumber(double n);
+        void                writeStartArray()                           { bytes.push_back(0x9F); }
+        void                writeEndArray()                             { bytes.push_back(0xFF); }
+        void                writeStartObject()                          { bytes.push_back(0xBF); }
+        void                writeEndObject()                            { bytes.push_back(0xFF); }
+        void                writeKey(const char * first, const char * last) { writeString(first, last); }
+        void                writeKey(const char * name)                 { writeString(name, name + strlen(name)); }
+    };
 }
 
 #endif
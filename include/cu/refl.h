@@ -5,6 +5,8 @@
 #include "cu/json.h"
 #include "cu/math.h"
 
+#include <algorithm>
+
 namespace cu
 {
     // reflect<T>() - Produce an object describing the fields of a given class
@@ -13,16 +15,17 @@ namespace cu
     struct reflect_add_fields { std::vector<Field> & fields; template<class T> void operator() (const char * name, const T & field) { fields.push_back({ name, &typeid(T), reinterpret_cast<size_t>(&field) }); } };
     template<class T> Class reflect() { Class cl = { &typeid(T), sizeof(T), {} }; visit_fields(*reinterpret_cast<T *>(nullptr), reflect_add_fields{ cl.fields }); return cl; }
 
-    // toJson(...) - Generic serialization system
-    // Generic types use visit_fields() to create a JSON object
-    struct json_write_fields { JsonObject & obj; template<class T> void operator() (const char * name, const T & field) { obj.emplace_back(name, toJson(field)); } };
-    template<class T> JsonValue toJson(const T & obj) { JsonObject o; visit_fields(const_cast<T &>(obj), json_write_fields{ o }); return o; }
+    // json_has_fields<T>::value - Whether T is reflected with visit_fields(), rather than serialized by overloads of toJson and fromJson for T itself
+    struct json_visit_nothing { template<class T> void operator() (const char *, T &) {} };
+    template<class T> struct json_has_fields
+    {
+        template<class U> static std::true_type test(decltype(visit_fields(std::declval<U &>(), json_visit_nothing{})) *);
+        template<class U> static std::false_type test(...);
+        static const bool value = decltype(test<T>(nullptr))::value;
+    };
 
-    // For specific types, we can overload toJson with a specific encoding
-    template<class T> JsonValue toJson(const std::vector<T> & arr) { JsonArray a; for (const auto & val : arr) a.push_back(toJson(val)); return a; }
-    template<class T> JsonValue toJson(const vec<T, 4> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y), toJson(vec.z), toJson(vec.w) }; }
-    template<class T> JsonValue toJson(const vec<T, 3> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y), toJson(vec.z) }; }
-    template<class T> JsonValue toJson(const vec<T, 2> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y) }; }
+    // toJson(...) - Generic serialization system
+    // Fundamental types map directly onto JsonValues, and are declared first so that the templates below can find them
     inline JsonValue toJson(const std::string & s) { return s; }
     inline JsonValue toJson(int16_t             n) { return n; }
     inline JsonValue toJson(uint16_t            n) { return n; }
@@ -33,6 +36,39 @@ namespace cu
     inline JsonValue toJson(float               n) { return n; }
     inline JsonValue toJson(double              n) { return n; }
     inline JsonValue toJson(bool                b) { return b; }
+    inline JsonValue toJson(const JsonValue &   v) { return v; }
+    template<class T> JsonValue toJson(const std::vector<T> & arr);
+    template<class T> JsonValue toJson(const T & obj);
+
+    // Generic types use visit_fields() to create a JSON object
+    struct json_write_fields { JsonObject & obj; template<class T> void operator() (const char * name, const T & field) { obj.emplace_back(name, toJson(field)); } };
+    template<class T> JsonValue toJson(const T & obj) { JsonObject o; visit_fields(const_cast<T &>(obj), json_write_fields{ o }); return o; }
+
+    // For specific types, we can overload toJson with a specific encoding
+    template<class T> JsonValue toJson(const std::vector<T> & arr) { JsonArray a; a.reserve(arr.size()); for (const auto & val : arr) a.push_back(toJson(val)); return a; }
+    template<class T> JsonValue toJson(const vec<T, 4> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y), toJson(vec.z), toJson(vec.w) }; }
+    template<class T> JsonValue toJson(const vec<T, 3> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y), toJson(vec.z) }; }
+    template<class T> JsonValue toJson(const vec<T, 2> & vec) { return JsonArray{ toJson(vec.x), toJson(vec.y) }; }
+
+    // toJson(..., writer) - Encode directly to JSON text with a JsonWriter, or to CBOR with a CborWriter, without building JsonValues, with the same results as writing toJson(...)
+    template<class W> void toJson(const std::string & s, W & out) { out.writeString(s.data(), s.data() + s.size()); }
+    template<class W> void toJson(int16_t             n, W & out) { out.writeNumber(static_cast<int64_t>(n)); }
+    template<class W> void toJson(uint16_t            n, W & out) { out.writeNumber(static_cast<uint64_t>(n)); }
+    template<class W> void toJson(int32_t             n, W & out) { out.writeNumber(static_cast<int64_t>(n)); }
+    template<class W> void toJson(uint32_t            n, W & out) { out.writeNumber(static_cast<uint64_t>(n)); }
+    template<class W> void toJson(int64_t             n, W & out) { out.writeNumber(n); }
+    template<class W> void toJson(uint64_t            n, W & out) { out.writeNumber(n); }
+    template<class W> void toJson(float               n, W & out) { out.writeNumber(n); }
+    template<class W> void toJson(double              n, W & out) { out.writeNumber(n); }
+    template<class W> void toJson(bool                b, W & out) { out.writeBool(b); }
+    template<class W> void toJson(const JsonValue &   v, W & out) { out.write(v); }
+    template<class W> struct json_encode_fields { W & out; template<class T> void operator() (const char * name, const T & field) { out.writeKey(name); toJson(field, out); } };
+    template<class T, class W> typename std::enable_if<json_has_fields<T>::value>::type toJson(const T & obj, W & out) { out.writeStartObject(); visit_fields(const_cast<T &>(obj), json_encode_fields<W>{ out }); out.writeEndObject(); }
+    template<class T, class W> typename std::enable_if<!json_has_fields<T>::value>::type toJson(const T & obj, W & out) { out.write(toJson(obj)); } // Types with their own toJson(const T &)
+    template<class T, class W> void toJson(const std::vector<T> & arr, W & out) { out.writeStartArray(); for (const auto & val : arr) toJson(val, out); out.writeEndArray(); }
+    template<class T, class W> void toJson(const vec<T, 4> & vec, W & out) { out.writeStartArray(); toJson(vec.x, out); toJson(vec.y, out); toJson(vec.z, out); toJson(vec.w, out); out.writeEndArray(); }
+    template<class T, class W> void toJson(const vec<T, 3> & vec, W & out) { out.writeStartArray(); toJson(vec.x, out); toJson(vec.y, out); toJson(vec.z, out); out.writeEndArray(); }
+    template<class T, class W> void toJson(const vec<T, 2> & vec, W & out) { out.writeStartArray(); toJson(vec.x, out); toJson(vec.y, out); out.writeEndArray(); }
 
     // fromJson(...) - Generic deserialization system
     // Generic types use visit_fields() to read from a JSON object
@@ -40,7 +76,27 @@ namespace cu
     template<class T> void fromJson(T & obj, const JsonValue & val) { visit_fields(obj, json_read_fields{ val }); }
 
     // For specific types, we can overload fromJson with a specific encoding
-    template<class T> void fromJson(std::vector<T> & arr, const JsonValue & val) { arr.resize(val.array().size()); for (size_t i = 0; i<arr.size(); ++i) fromJson(arr[i], val[i]); }
+    // Packed Arrays of numbers are read without creating JsonValues for their elements, but convert each number exactly as fromJson(n, JsonValue(n)) would
+    template<class T, class N> void json_read_numbers(T & out, array_ref<N> nums) { for (size_t i = 0; i < nums.size(); ++i) fromJson(out[static_cast<int>(i)], JsonValue(nums[i])); }
+    template<class T> void fromJson(std::vector<T> & arr, const JsonValue & val)
+    {
+        auto ints = val.packedIntegers(); auto reals = val.packedReals(); auto floats = val.packedFloats();
+        if (!ints.empty() || !reals.empty() || !floats.empty()) { arr.resize(ints.size() + reals.size() + floats.size()); json_read_numbers(arr, ints); json_read_numbers(arr, reals); json_read_numbers(arr, floats); return; }
+        arr.resize(val.array().size()); for (size_t i = 0; i<arr.size(); ++i) fromJson(arr[i], val[i]);
+    }
+    template<class T, int N> void fromJson(std::vector<vec<T, N>> & arr, const JsonValue & val)
+    {
+        auto elements = val.array();
+        arr.resize(elements.size());
+        for (size_t i = 0; i < arr.size(); ++i)
+        {
+            auto ints = elements[i].packedIntegers(); auto reals = elements[i].packedReals(); auto floats = elements[i].packedFloats();
+            if (ints.size() >= static_cast<size_t>(N)) json_read_numbers(arr[i], array_ref<int64_t>{ ints.begin(), ints.begin() + N });
+            else if (reals.size() >= static_cast<size_t>(N)) json_read_numbers(arr[i], array_ref<double>{ reals.begin(), reals.begin() + N });
+            else if (floats.size() >= static_cast<size_t>(N)) json_read_numbers(arr[i], array_ref<float>{ floats.begin(), floats.begin() + N });
+            else fromJson(arr[i], elements[i]);
+        }
+    }
     template<class T> void fromJson(vec<T, 4> & vec, const JsonValue & val) { fromJson(vec.x, val[0]); fromJson(vec.y, val[1]); fromJson(vec.z, val[2]); fromJson(vec.w, val[3]); }
     template<class T> void fromJson(vec<T, 3> & vec, const JsonValue & val) { fromJson(vec.x, val[0]); fromJson(vec.y, val[1]); fromJson(vec.z, val[2]); }
     template<class T> void fromJson(vec<T, 2> & vec, const JsonValue & val) { fromJson(vec.x, val[0]); fromJson(vec.y, val[1]); }
@@ -54,10 +110,99 @@ namespace cu
     inline void fromJson(float       & n, const JsonValue & val) { n = val.number<float   >(); }
     inline void fromJson(double      & n, const JsonValue & val) { n = val.number<double  >(); }
     inline void fromJson(bool        & b, const JsonValue & val) { b = val.isTrue(); }
+    inline void fromJson(JsonValue   & v, const JsonValue & val) { v = val; }
+
+    // fromJson(..., JsonReader &) - Decode directly from JSON text, without building JsonValues, with the same results as fromJson(..., jsonFrom(text))
+    // Members are matched to fields by name, the first of several members with the same name wins, and anything missing or of the wrong kind decodes as null
+    struct json_reset_fields { template<class T> void operator() (const char *, T & field) { fromJson(field, JsonValue()); } };
+    struct json_field_decoder { const char * name; size_t length, offset; void (* decode)(void * field, JsonReader & in); }; // Where to find a field of a reflected type, and how to decode it
+    inline bool operator < (const json_field_decoder & a, const json_field_decoder & b) { return a.length != b.length ? a.length < b.length : memcmp(a.name, b.name, a.length) < 0; }
+    template<class T> void json_decode_at(void * field, JsonReader & in) { fromJson(*static_cast<T *>(field), in); }
+    struct json_add_decoders { std::vector<json_field_decoder> & decoders; const char * base; template<class T> void operator() (const char * name, T & field) { decoders.push_back({ name, strlen(name), static_cast<size_t>(reinterpret_cast<const char *>(&field) - base), &json_decode_at<T> }); } };
+    template<class T> const std::vector<json_field_decoder> & json_field_decoders(T & obj)
+    {
+        // Built once per type, from the offsets of the fields of the first object decoded, and sorted by name so that each key is found by binary search
+        static const std::vector<json_field_decoder> decoders = [&obj]() { std::vector<json_field_decoder> d; visit_fields(obj, json_add_decoders{ d, reinterpret_cast<const char *>(&obj) }); std::stable_sort(d.begin(), d.end()); return d; }();
+        return decoders;
+    }
+    template<class T> typename std::enable_if<json_has_fields<T>::value>::type fromJson(T & obj, JsonReader & in)
+    {
+        visit_fields(obj, json_reset_fields{});
+        if (in.peek() != JsonReader::Object) return in.skip();
+        auto & fields = json_field_decoders(obj);
+        uint64_t few = 0; std::vector<uint64_t> many(fields.size() > 64 ? (fields.size() + 63) / 64 : 0); // Which fields have been decoded
+        auto seen = many.empty() ? &few : many.data();
+        if (in.readStartObject()) do
+        {
+            auto key = in.readKey();
+            auto field = std::lower_bound(fields.begin(), fields.end(), json_field_decoder{ key.data(), key.size(), 0, nullptr });
+            auto i = field - fields.begin();
+            if (field == fields.end() || field->length != key.size() || memcmp(field->name, key.data(), key.size()) != 0 || (seen[i / 64] >> (i % 64) & 1)) { in.skip(); continue; }
+            seen[i / 64] |= 1ULL << (i % 64);
+            field->decode(reinterpret_cast<char *>(&obj) + field->offset, in);
+        } while (in.readNextMember());
+    }
+    template<class T> typename std::enable_if<!json_has_fields<T>::value>::type fromJson(T & obj, JsonReader & in) { fromJson(obj, static_cast<const JsonValue &>(in.readValue())); } // Types with their own fromJson(T &, const JsonValue &)
+    template<class T> void fromJson(std::vector<T> & arr, JsonReader & in)
+    {
+        arr.clear();
+        if (in.peek() != JsonReader::Array) return in.skip();
+        if (in.readStartArray()) do { arr.emplace_back(); fromJson(arr.back(), in); } while (in.readNextElement());
+    }
+    template<class T, int N> void json_decode_vec(vec<T, N> & vec, JsonReader & in)
+    {
+        for (int i = 0; i < N; ++i) fromJson(vec[i], JsonValue());
+        if (in.peek() != JsonReader::Array) return in.skip();
+        int i = 0;
+        if (in.readStartArray()) do { if (i < N) fromJson(vec[i++], in); else in.skip(); } while (in.readNextElement());
+    }
+    template<class T> void fromJson(vec<T, 4> & vec, JsonReader & in) { json_decode_vec(vec, in); }
+    template<class T> void fromJson(vec<T, 3> & vec, JsonReader & in) { json_decode_vec(vec, in); }
+    template<class T> void fromJson(vec<T, 2> & vec, JsonReader & in) { json_decode_vec(vec, in); }
+    template<class T> T json_decode_number(JsonReader & in) { if (in.peek() == JsonReader::Number) return in.readNumber().number<T>(); in.skip(); return T(); }
+    inline void fromJson(std::string & s, JsonReader & in) { if (in.peek() == JsonReader::String) { auto str = in.readString(); s.assign(str.begin(), str.end()); } else { in.skip(); s.clear(); } }
+    inline void fromJson(int16_t     & n, JsonReader & in) { n = json_decode_number<int32_t >(in); }
+    inline void fromJson(uint16_t    & n, JsonReader & in) { n = json_decode_number<uint32_t>(in); }
+    inline void fromJson(int32_t     & n, JsonReader & in) { n = json_decode_number<int32_t >(in); }
+    inline void fromJson(uint32_t    & n, JsonReader & in) { n = json_decode_number<uint32_t>(in); }
+    inline void fromJson(int64_t     & n, JsonReader & in) { n = json_decode_number<int64_t >(in); }
+    inline void fromJson(uint64_t    & n, JsonReader & in) { n = json_decode_number<uint64_t>(in); }
+    inline void fromJson(float       & n, JsonReader & in) { n = json_decode_number<float   >(in); }
+    inline void fromJson(double      & n, JsonReader & in) { n = json_decode_number<double  >(in); }
+    inline void fromJson(bool        & b, JsonReader & in) { b = in.peek() == JsonReader::True; in.skip(); }
+    inline void fromJson(JsonValue   & v, JsonReader & in) { v = in.readValue(); }
+
+    // fromJson(..., JsonValue &&) - Decode from a value which is no longer needed, with the same results as fromJson(..., const JsonValue &), but moving rather than
+    // copying any strings and JsonValue fields whose storage is not shared with other values
+    struct json_take_fields { JsonValue & val; template<class T> void operator() (const char * name, T & field) { fromJson(field, val.takeMember(name)); } };
+    template<class T> typename std::enable_if<json_has_fields<T>::value>::type fromJson(T & obj, JsonValue && val) { visit_fields(obj, json_take_fields{ val }); }
+    template<class T> typename std::enable_if<!json_has_fields<T>::value>::type fromJson(T & obj, JsonValue && val) { fromJson(obj, static_cast<const JsonValue &>(val)); } // Types with their own fromJson(T &, const JsonValue &)
+    template<class T> void fromJson(std::vector<T> & arr, JsonValue && val)
+    {
+        if (!val.packedIntegers().empty() || !val.packedReals().empty() || !val.packedFloats().empty()) return fromJson(arr, static_cast<const JsonValue &>(val));
+        auto elements = val.takeArray();
+        arr.resize(elements.size()); for (size_t i = 0; i < arr.size(); ++i) fromJson(arr[i], std::move(elements[i]));
+    }
+    template<class T, int N> void fromJson(std::vector<vec<T, N>> & arr, JsonValue && val) { fromJson(arr, static_cast<const JsonValue &>(val)); }
+    template<class T, int N> void fromJson(vec<T, N> & vec, JsonValue && val) { fromJson(vec, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(std::string & s, JsonValue && val) { s = val.takeString(); }
+    inline void fromJson(int16_t     & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(uint16_t    & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(int32_t     & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(uint32_t    & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(int64_t     & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(uint64_t    & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(float       & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(double      & n, JsonValue && val) { fromJson(n, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(bool        & b, JsonValue && val) { fromJson(b, static_cast<const JsonValue &>(val)); }
+    inline void fromJson(JsonValue   & v, JsonValue && val) { v = std::move(val); }
 
     // Utility methods
-    template<class T> std::string encodeJson(const T & obj) { std::ostringstream ss; ss << toJson(obj); return ss.str(); }
-    template<class T> T decodeJson(const std::string & text) { T obj; fromJson(obj, jsonFrom(text)); return obj; }
+    template<class T> std::string encodeJson(const T & obj) { JsonWriter w; toJson(obj, w); return w.str(); }
+    template<class T> std::ostream & encodeJson(std::ostream & out, const T & obj) { JsonWriter w([&out](const char * first, const char * last) { out.write(first, last - first); }); toJson(obj, w); w.flush(); return out; }
+    template<class T> T decodeJson(const std::string & text) { T obj; JsonReader in(text.data(), text.data() + text.size()); fromJson(obj, in); in.readEnd(); return obj; }
+    template<class T> std::vector<uint8_t> encodeCbor(const T & obj) { CborWriter w; toJson(obj, w); return std::move(w.bytes); }
+    template<class T> T decodeCbor(const std::vector<uint8_t> & data) { JsonParseOptions options; options.borrow = true; options.packNumbers = true; T obj; fromJson(obj, jsonFromCbor(data, options)); return obj; }
 
     // Support UserTypes as follows: 
     //   template<class F> void visit_fields(UserType & o, F f) { f("alpha", o.alpha); f("beta", o.beta); ... }
@@ -0,0 +1,116 @@
+// Checks that JSON values and reflected types survive a round trip through CBOR exactly as they do through JSON text, then compares the
+// throughput of both encodings on the benchmark corpus. Usage: cbor_test [file...]. Returns 1 if any check fails.
+#include "../json_bench/corpus.h"
+#include <cu/refl.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace cu;
+
+struct Record { std::string name; int32_t id; uint64_t big; bool flag; float weight; double precise; float3 position; std::vector<int16_t> counts; std::vector<float2> path; };
+template<class F> void visit_fields(Record & o, F f) { f("name", o.name); f("id", o.id); f("big", o.big); f("flag", o.flag); f("weight", o.weight); f("precise", o.precise); f("position", o.position); f("counts", o.counts); f("path", o.path); }
+
+static int failures = 0;
+
+static void check(bool passed, const std::string & what)
+{
+    if (passed) return;
+    std::cout << "FAILED: " << what << std::endl;
+    ++failures;
+}
+
+static std::string text(const JsonValue & val) { JsonWriter writer; writer.write(val); return writer.str(); }
+
+// A document read from CBOR must equal the same document read from its text, with and without packed numbers, and write back the same text
+static void checkRoundTrip(const std::string & name, const std::string & json)
+{
+    for (bool pack : { false, true })
+    {
+        JsonParseOptions options;
+        options.packNumbers = pack;
+        auto val = jsonFrom(json, options);
+        auto cbor = cborFrom(val);
+        auto back = jsonFromCbor(cbor, options);
+        check(back == val, name + (pack ? " (packed)" : "") + ": value read from CBOR differs from value read from text");
+        check(text(back) == text(val), name + (pack ? " (packed)" : "") + ": text written from CBOR differs from text written from text");
+        check(cborFrom(back) == cbor, name + (pack ? " (packed)" : "") + ": CBOR written from CBOR differs");
+    }
+}
+
+static void checkValues()
+{
+    const char * documents[] = {
+        "null", "true", "false", "0", "-1", "23", "24", "255", "256", "65535", "65536", "4294967295", "4294967296",
+        "9223372036854775807", "-9223372036854775808", "18446744073709551615", "0.5", "-1.25", "3.141592653589793", "1e+300", "5e-324",
+        "\"\"", "\"plain\"", "\"esc\\\"aped\\\\ \\n\\t\\u0001\"", "\"\xC3\xA9t\xC3\xA9 \xE6\x97\xA5\xE6\x9C\xAC \xF0\x9F\x99\x82\"",
+        "[]", "{}", "[[],{},[[]]]", "[1,2,3]", "[1,2.5,-3]", "[0.25,-0.5,1e+100]", "[1,\"a\",null,true,[2],{\"b\":3}]",
+        "{\"a\":1,\"b\":[1,2],\"c\":{\"d\":\"e\"},\"\":null}", "{\"dup\":1,\"dup\":2}"
+    };
+    for (auto doc : documents) checkRoundTrip(doc, doc);
+
+    std::string deep;
+    for (int i = 0; i < 250; ++i) deep += "[{\"a\":";
+    deep += "1";
+    for (int i = 0; i < 250; ++i) deep += "}]";
+    checkRoundTrip("500 levels of nesting", deep);
+}
+
+static void checkReflected()
+{
+    Record r = { "record \xC3\xA9", -42, 18446744073709551615ULL, true, 0.1f, 0.1, { 1.5f, -2, 1e10f }, { -32768, 0, 32767 }, { { 0, 1 }, { 0.25f, -0.75f } } };
+    auto viaText = decodeJson<Record>(encodeJson(r)), viaCbor = decodeCbor<Record>(encodeCbor(r));
+    check(encodeJson(viaCbor) == encodeJson(viaText), "reflected Record read from CBOR differs from Record read from text");
+    check(jsonFromCbor(encodeCbor(r)) == toJson(r), "CBOR encoded from a Record differs from toJson(Record)"); // encodeCbor writes arrays and maps of indefinite length, so compare values rather than bytes
+}
+
+template<class F> static double bestTime(F f)
+{
+    double best = 1e9;
+    for (int i = 0; i < 5; ++i)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count());
+    }
+    return best;
+}
+
+static void bench(const std::string & name, const std::string & json)
+{
+    JsonParseOptions options;
+    options.packNumbers = true;
+    auto val = jsonFrom(json, options);
+    auto cbor = cborFrom(val);
+    auto parse = bestTime([&]() { jsonFrom(json, options); }), decode = bestTime([&]() { jsonFromCbor(cbor, options); });
+    auto write = bestTime([&]() { text(val); }), encode = bestTime([&]() { cborFrom(val); });
+    printf("%-16s text %6.1f MB: read %6.0f ms write %6.0f ms   CBOR %6.1f MB: read %6.0f ms write %6.0f ms\n", name.c_str(), json.size() / 1e6, parse * 1e3, write * 1e3, cbor.size() / 1e6, decode * 1e3, encode * 1e3);
+}
+
+int main(int argc, char * argv[])
+{
+    try
+    {
+        checkValues();
+        checkReflected();
+        std::vector<CorpusDocument> docs;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::ifstream in(argv[i], std::ios::binary);
+            if (!in) throw std::runtime_error(std::string("cannot read ") + argv[i]);
+            docs.push_back({ argv[i], std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) });
+        }
+        if (docs.empty()) docs = generateCorpus(8 << 20);
+        for (auto & doc : docs) checkRoundTrip(doc.name, doc.text);
+        std::cout << (failures ? "Round trips FAILED" : "Round trips passed") << std::endl;
+        for (auto & doc : docs) bench(doc.name, doc.text);
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
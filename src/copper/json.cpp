@@ -2,11 +2,72 @@
 #include "cu/json.h"
 
 #include <algorithm>
+#include <clocale>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <type_traits>
 #include <regex>
+#include <thread>
+
+#if defined(COPPER_JSON_NO_SIMD)
+// Only the scalar loops are used, for comparison
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define COPPER_JSON_SIMD 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COPPER_JSON_SIMD 16
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace cu 
 { 
-    std::ostream & printEscaped(std::ostream & out, const std::string & str)
+    // Store value in slot, which is built lazily by const member functions, unless another thread got there first, and return what the slot then holds.
+    // Several threads may race to build the same contents, in which case only the first one to finish publishes its copy, and the others discard theirs.
+    template<class P> static typename P::pointer publishOnce(std::atomic<typename P::pointer> & slot, P value)
+    {
+        typename P::pointer expected = nullptr;
+        if (slot.compare_exchange_strong(expected, value.get(), std::memory_order_acq_rel)) return value.release();
+        return expected;
+    }
+
+    void JsonWriter::makeRoom(size_t n)
+    {
+        if (sink) flush();
+        if (static_cast<size_t>(limit - next) >= n) return;
+        auto used = size(), capacity = std::max(static_cast<size_t>(limit - buffer.get()) * 2, used + std::max(n, size_t(256)));
+        std::unique_ptr<char[]> grown(new char[capacity]);
+        if (used) memcpy(grown.get(), buffer.get(), used);
+        buffer = std::move(grown);
+        next = buffer.get() + used;
+        limit = buffer.get() + capacity;
+    }
+
+    void JsonWriter::putIndent(int space, int n)
+    {
+        auto out = reserve(space + 2);
+        if (n) *out++ = ',';
+        *out++ = '\n';
+        next = std::fill_n(out, space, ' ');
+    }
+
+    void JsonWriter::putString(const char * first, const char * last)
     {
         // Escape sequences for ", \, and control characters, 0 indicates no escaping needed
         static const char * escapes[256] = {
@@ -18,289 +79,2571 @@ namespace cu
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "\\\\", 0, 0, 0,
             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, "\\u007F"
         };
-        out << '"';
-        for (uint8_t ch : str)
+        put('"');
+        while (first != last)
         {
-            if (escapes[ch]) out << escapes[ch];
-            else out << ch;
+            // Copy the longest run of characters which need no escaping in one go
+            auto run = first;
+            while (run != last && !escapes[static_cast<uint8_t>(*run)]) ++run;
+            put(first, run);
+            if (run == last) break;
+            auto escape = escapes[static_cast<uint8_t>(*run)];
+            put(escape, escape + strlen(escape));
+            first = run + 1;
         }
-        return out << '"';
+        put('"');
     }
 
-    std::ostream & operator << (std::ostream & out, const JsonArray & arr)
+    void JsonWriter::putLine(const JsonValue & val)
     {
-        int i = 0;
-        out << '[';
-        for (auto & val : arr) out << (i++ ? "," : "") << val;
-        return out << ']';
+        static const char null[] = "null", no[] = "false", yes[] = "true";
+        char buffer[32];
+        switch (val.kind)
+        {
+        case JsonValue::Null: return put(null, null + 4);
+        case JsonValue::False: return put(no, no + 5);
+        case JsonValue::True: return put(yes, yes + 4);
+        case JsonValue::String: return putString(val.chars(), val.chars() + val.size);
+        case JsonValue::Number: { auto text = val.numberText(buffer); return put(text.begin(), text.end()); }
+        case JsonValue::Array:
+            if (val.cached) return putNumbers(val);
+            put('[');
+            for (auto & elem : val.array())
+            {
+                if (&elem != val.array().begin()) put(',');
+                putLine(elem); // Never an Array or Object, so this recurses at most once
+            }
+            return put(']');
+        case JsonValue::Object: return put("{}", "{}" + 2);
+        }
     }
 
-    std::ostream & operator << (std::ostream & out, const JsonObject & obj)
+    void JsonWriter::putNumbers(const JsonValue & arr)
     {
-        int i = 0;
-        out << '{';
-        for (auto & kvp : obj)
+        put('[');
+        for (auto & n : arr.packedIntegers())
+        {
+            if (&n != arr.packedIntegers().begin()) put(',');
+            next = formatJsonNumber(reserve(32), n);
+        }
+        for (auto & n : arr.packedReals())
         {
-            printEscaped(out << (i++ ? "," : ""), kvp.first) << ':' << kvp.second;
+            if (&n != arr.packedReals().begin()) put(',');
+            next = formatJsonNumber(reserve(32), n);
         }
-        return out << '}';
+        for (auto & n : arr.packedFloats())
+        {
+            if (&n != arr.packedFloats().begin()) put(',');
+            next = formatJsonNumber(reserve(32), n);
+        }
+        put(']');
+    }
+
+    bool JsonWriter::putCached(const JsonValue & val, int tabWidth, int indent)
+    {
+        auto slot = maxCached ? val.fragment() : nullptr;
+        auto text = slot ? slot->load(std::memory_order_acquire) : nullptr;
+        if (!text || text->tabWidth != (indent < 0 ? 0 : tabWidth) || text->indent != std::max(indent, -1)) return false;
+        put(text->text.data(), text->text.data() + text->text.size());
+        return true;
+    }
+
+    void JsonWriter::cache(const JsonValue & val, size_t start, int tabWidth, int indent)
+    {
+        auto slot = maxCached ? val.fragment() : nullptr;
+        if (!slot || start < flushed || slot->load(std::memory_order_relaxed)) return;
+        auto first = buffer.get() + (start - flushed);
+        auto n = static_cast<size_t>(next - first);
+        if (n < minCached || n > maxCached) return;
+        publishOnce(*slot, std::unique_ptr<JsonFragment>(new JsonFragment{ std::string(first, next), indent < 0 ? 0 : tabWidth, std::max(indent, -1) }));
     }
 
-    std::ostream & operator << (std::ostream & out, const JsonValue & val)
+    void JsonWriter::putTree(const JsonValue & root, int tabWidth, int indent)
     {
-        if (val.isNull()) return out << "null";
-        else if (val.isFalse()) return out << "false";
-        else if (val.isTrue()) return out << "true";
-        else if (val.isString()) return printEscaped(out, val.contents());
-        else if (val.isNumber()) return out << val.contents();
-        else if (val.isArray()) return out << val.array();
-        else return out << val.object();
+        // Arrays and objects which have been started are kept on an explicit stack, so that values nested arbitrarily deeply can be written without recursion
+        auto base = stack.size();
+        auto val = &root;
+        while (true)
+        {
+            // Start an array or object which is written one element or member at a time, or write a value on one line, as Arrays holding no arrays or
+            // objects always are, unless its text has been cached
+            if (!putCached(*val, tabWidth, indent))
+            {
+                if (val->isArray() && !val->cached && std::any_of(val->array().begin(), val->array().end(), [](const JsonValue & elem) { return elem.isArray() || elem.isObject(); }))
+                {
+                    auto arr = val->array();
+                    stack.push_back({ arr.begin() + 1, arr.end(), nullptr, nullptr, indent, val, flushed + size() });
+                    put('[');
+                    if (indent >= 0) putIndent(indent += tabWidth);
+                    val = arr.begin();
+                    continue;
+                }
+                if (val->isObject() && !val->object().empty())
+                {
+                    auto obj = val->object();
+                    stack.push_back({ nullptr, nullptr, obj.begin() + 1, obj.end(), indent, val, flushed + size() });
+                    put('{');
+                    if (indent >= 0) putIndent(indent += tabWidth);
+                    putString(obj.begin()->first.begin(), obj.begin()->first.end());
+                    if (indent >= 0) put(": ", ": " + 2); else put(':');
+                    val = &obj.begin()->second;
+                    continue;
+                }
+                auto start = flushed + size();
+                putLine(*val);
+                if (val->isArray()) cache(*val, start, tabWidth, indent);
+            }
+
+            // End any arrays and objects which are complete, then move on to the next element or member of the innermost one left
+            while (true)
+            {
+                if (stack.size() == base) return;
+                auto & frame = stack.back();
+                indent = frame.indent;
+                if (frame.value != frame.lastValue)
+                {
+                    if (indent >= 0) putIndent(indent += tabWidth, 1); else put(',');
+                    val = frame.value++;
+                    break;
+                }
+                if (frame.member != frame.lastMember)
+                {
+                    if (indent >= 0) putIndent(indent += tabWidth, 1); else put(',');
+                    putString(frame.member->first.begin(), frame.member->first.end());
+                    if (indent >= 0) put(": ", ": " + 2); else put(':');
+                    val = &frame.member++->second;
+                    break;
+                }
+                if (indent >= 0) putIndent(indent);
+                put(frame.lastValue ? ']' : '}');
+                cache(*frame.container, frame.start, tabWidth, indent);
+                stack.pop_back();
+            }
+        }
     }
 
-    static std::ostream & indent(std::ostream & out, int space, int n = 0)
+    // Stream output goes through a small JsonWriter, so that the stream sees a few large writes rather than many small ones
+    template<class T> static std::ostream & print(std::ostream & out, const T & value)
     {
-        if (n) out << ',';
-        out << '\n';
-        for (int i = 0; i < space; ++i) out << ' ';
+        JsonWriter writer([&out](const char * first, const char * last) { out.write(first, last - first); }, 4096);
+        writer.write(value);
+        writer.flush();
         return out;
     }
 
-    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonArray> arr)
+    std::ostream & operator << (std::ostream & out, const JsonValue & val) { return print(out, val); }
+    std::ostream & operator << (std::ostream & out, array_ref<JsonValue> arr) { return print(out, arr); }
+    std::ostream & operator << (std::ostream & out, array_ref<JsonMember> obj) { return print(out, obj); }
+    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonValue> val) { return print(out, val); }
+    std::ostream & operator << (std::ostream & out, tabbed_ref<array_ref<JsonValue>> arr) { return print(out, arr); }
+    std::ostream & operator << (std::ostream & out, tabbed_ref<array_ref<JsonMember>> obj) { return print(out, obj); }
+
+    bool JsonValue::operator == (const JsonValue & r) const
+    {
+        if (kind != r.kind) return false;
+        if ((kind == Array || kind == Object) && data == r.data && size == r.size && cached == r.cached) return true; // Copies, and subtrees shared by JsonParseOptions::shareSubtrees
+        if (auto a = memo()) if (auto b = r.memo())
+        {
+            auto x = a->load(std::memory_order_relaxed), y = b->load(std::memory_order_relaxed);
+            if (x && y && x != y) return false;
+        }
+        switch (kind)
+        {
+        case String: return size == r.size && (data == r.data || memcmp(data, r.data, size) == 0);
+        case Number: { char x[32], y[32]; auto a = numberText(x), b = r.numberText(y); return a.size() == b.size() && memcmp(a.begin(), b.begin(), a.size()) == 0; }
+        case Array:
+            if (cached && cached == r.cached) return size == r.size && memcmp(data, r.data, size * (cached == Single ? sizeof(float) : sizeof(double))) == 0; // Equal numbers have equal bits
+            if (cached || r.cached)
+            {
+                // Compare packed elements one at a time rather than unpacking them, as the parser may still be filling the block they are stored in
+                if (size != r.size) return false;
+                for (size_t i = 0; i < size; ++i) if (packedElement(i) != r.packedElement(i)) return false;
+                return true;
+            }
+            { auto a = array(), b = r.array(); return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin()); }
+        case Object: { auto a = object(), b = r.object(); return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin()); }
+        default: return true;
+        }
+    }
+
+    static size_t hash(const char * first, size_t length)
+    {
+        // Multiply in eight characters at a time, then mix the high bits down into the low ones, which index the tables this is used for
+        uint64_t h = 14695981039346656037ULL ^ length, word;
+        for (; length >= 8; first += 8, length -= 8) { memcpy(&word, first, 8); h = (h ^ word) * 0x9E3779B97F4A7C15ULL; h ^= h >> 32; }
+        if (length) { word = 0; memcpy(&word, first, length); h = (h ^ word) * 0x9E3779B97F4A7C15ULL; }
+        h = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ULL;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    std::atomic<JsonFragment *> * JsonValue::fragment() const
+    {
+        if (!owner || cached) return nullptr;
+        if (kind == Array) { auto block = static_cast<JsonArrayBlock *>(owner); return block->lent ? nullptr : &block->text; }
+        if (kind == Object) { auto block = static_cast<JsonObjectBlock *>(owner); return block->lent ? nullptr : &block->text; }
+        return nullptr;
+    }
+
+    std::atomic<size_t> * JsonValue::memo() const
+    {
+        if (!owner || cached) return nullptr; // Packed Arrays share their block with others
+        if (kind == Array) { auto block = static_cast<JsonArrayBlock *>(owner); return block->lent ? nullptr : &block->hash; }
+        if (kind == Object) { auto block = static_cast<JsonObjectBlock *>(owner); return block->lent ? nullptr : &block->hash; }
+        return nullptr;
+    }
+
+    size_t JsonValue::hash() const
+    {
+        auto memo = this->memo();
+        if (memo && memo->load(std::memory_order_relaxed)) return memo->load(std::memory_order_relaxed);
+
+        // Mix in the hashes of strings, of the text of numbers, as compared by operator ==, and of elements and members in order, using 64-bit FNV-1a
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](uint64_t x) { h = (h ^ x) * 1099511628211ULL; };
+        mix(kind);
+        char buffer[32];
+        switch (kind)
+        {
+        case String: mix(cu::hash(chars(), size)); break;
+        case Number: { auto text = numberText(buffer); mix(cu::hash(text.begin(), text.size())); } break;
+        case Array:
+            for (auto n : packedIntegers()) mix(JsonValue(n).hash()); // Hash packed elements as array() would unpack them, without creating them
+            for (auto n : packedReals()) mix(JsonValue(n).hash());
+            for (auto n : packedFloats()) mix(JsonValue(n).hash());
+            if (!cached) for (auto & elem : array()) mix(elem.hash());
+            break;
+        case Object: for (auto & kvp : object()) { mix(cu::hash(kvp.first.data(), kvp.first.size())); mix(kvp.second.hash()); } break;
+        default: break;
+        }
+        auto result = static_cast<size_t>(h ^ (h >> 32));
+        if (!result) result = 1; // 0 marks a hash which is not yet known
+        if (memo) memo->store(result, std::memory_order_relaxed); // Threads which race to hash the same value store the same result
+        return result;
+    }
+
+    enum { minIndexedMembers = 8 }; // Narrower objects are faster to scan than to hash
+    static size_t indexCapacity(size_t members) { size_t n = 16; while (n < members * 2) n *= 2; return n; }
+
+    template<class M> static void indexMember(uint32_t * index, const std::vector<M> & members, size_t i)
+    {
+        auto mask = indexCapacity(members.size()) - 1;
+        auto & key = members[i].first;
+        for (auto slot = hash(key.data(), key.size()) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (!index[slot]) { index[slot] = static_cast<uint32_t>(i + 1); break; }
+            if (members[index[slot] - 1].first == key) break; // Only the first of several members with the same name is reachable
+        }
+    }
+
+    static uint32_t * buildIndex(const JsonObject & members)
+    {
+        auto index = new uint32_t[indexCapacity(members.size())]();
+        for (size_t i = 0; i < members.size(); ++i) indexMember(index, members, i);
+        return index;
+    }
+
+    template<class M> static const M * findIndexed(const uint32_t * index, array_ref<M> members, const char * key, size_t length)
+    {
+        auto mask = indexCapacity(members.size()) - 1;
+        for (auto slot = hash(key, length) & mask; index[slot]; slot = (slot + 1) & mask)
+        {
+            auto & m = members[index[slot] - 1];
+            if (m.first.size() == length && (m.first.data() == key || memcmp(m.first.data(), key, length) == 0)) return &m;
+        }
+        return nullptr;
+    }
+
+    array_ref<JsonValue> JsonValue::unpack() const
+    {
+        auto & block = *static_cast<JsonNumbersBlock *>(owner);
+        auto values = block.values.load(std::memory_order_acquire);
+        if (!values)
+        {
+            std::unique_ptr<JsonValue[]> created(new JsonValue[block.integers.size() + block.reals.size() + block.floats.size()]);
+            std::copy(block.floats.begin(), block.floats.end(), std::copy(block.reals.begin(), block.reals.end(), std::copy(block.integers.begin(), block.integers.end(), created.get())));
+            values = publishOnce(block.values, std::move(created));
+        }
+        auto first = values + (cached == Integer ? static_cast<const int64_t *>(data) - block.integers.data() : block.integers.size() + (cached == Real ? static_cast<const double *>(data) - block.reals.data() : block.reals.size() + (static_cast<const float *>(data) - block.floats.data())));
+        return{ first, first + size };
+    }
+
+    const JsonMember * JsonValue::find(const char * key, size_t length) const
+    {
+        auto obj = object();
+        if (owner && obj.size() >= minIndexedMembers)
+        {
+            auto & block = *static_cast<JsonObjectBlock *>(owner);
+            auto index = block.index.load(std::memory_order_acquire);
+            if (!index) index = publishOnce(block.index, std::unique_ptr<uint32_t[]>(buildIndex(block.members)));
+            return findIndexed(index, obj, key, length);
+        }
+        for (auto & kvp : obj) if (kvp.first.size() == length && (kvp.first.data() == key || memcmp(kvp.first.data(), key, length) == 0)) return &kvp; // Parsed keys are interned, so a key taken from one Object matches others by address
+        return nullptr;
+    }
+
+    const JsonValue & JsonValue::member(const char * key, size_t length) const
+    {
+        const static JsonValue null;
+        auto kvp = find(key, length);
+        return kvp ? kvp->second : null;
+    }
+
+    std::string JsonValue::takeString()
+    {
+        std::string s;
+        if (kind == String && owner && owner->refs == 1)
+        {
+            // Strings too long to pack into shared blocks are given a block of their own, whose std::string can be taken whole
+            auto block = static_cast<JsonStringBlock *>(owner);
+            if (block->str.data() == data && block->str.size() == size) s = std::move(block->str);
+        }
+        if (s.empty() && kind == String) s.assign(chars(), size);
+        *this = JsonValue();
+        return s;
+    }
+
+    JsonArray JsonValue::takeArray()
+    {
+        JsonArray arr;
+        if (kind == Array && !cached && owner && owner->refs == 1) arr = std::move(static_cast<JsonArrayBlock *>(owner)->elements);
+        else if (kind == Array) { auto elements = array(); arr.assign(elements.begin(), elements.end()); }
+        *this = JsonValue();
+        return arr;
+    }
+
+    JsonObject JsonValue::takeObject()
+    {
+        JsonObject obj;
+        if (kind == Object && owner && owner->refs == 1) obj = std::move(static_cast<JsonObjectBlock *>(owner)->members);
+        else if (kind == Object) { auto members = object(); obj.assign(members.begin(), members.end()); }
+        *this = JsonValue();
+        return obj;
+    }
+
+    JsonValue JsonValue::takeMember(const char * key, size_t length)
     {
-        if (std::none_of(begin(arr.value), end(arr.value), [](const JsonValue & val) { return val.isArray() || val.isObject(); })) return out << arr.value;
-        else
+        auto kvp = find(key, length);
+        if (!kvp) return JsonValue();
+        auto position = kvp - object().begin();
+        return std::move(ownMembers()[position].second);
+    }
+
+    JsonArray & JsonValue::ownElements()
+    {
+        // Elements which are shared, borrowed, packed, or allocated from an arena are copied into a block of our own, which shares each of them with the original
+        if (kind != Array || cached || !owner || owner->refs != 1) *this = JsonValue(takeArray());
+        static_cast<JsonArrayBlock *>(owner)->hash = 0; // Elements may change through the returned reference
+        delete static_cast<JsonArrayBlock *>(owner)->text.exchange(nullptr);
+        return static_cast<JsonArrayBlock *>(owner)->elements;
+    }
+
+    JsonObject & JsonValue::ownMembers()
+    {
+        if (kind != Object || !owner || owner->refs != 1)
         {
-            int space = arr.indent + arr.tabWidth, i = 0;
-            out << '[';
-            for (auto & val : arr.value) indent(out, space, i++) << tabbed(val, arr.tabWidth, space);
-            return indent(out, arr.indent) << ']';
+            // The copied members keep their positions, so the index of a shared block serves the copy as well
+            uint32_t * index = nullptr;
+            if (auto shared = kind == Object && owner ? static_cast<JsonObjectBlock *>(owner)->index.load(std::memory_order_acquire) : nullptr)
+            {
+                index = new uint32_t[indexCapacity(size)];
+                std::copy(shared, shared + indexCapacity(size), index);
+            }
+            *this = JsonValue(takeObject());
+            static_cast<JsonObjectBlock *>(owner)->index = index;
         }
+        static_cast<JsonObjectBlock *>(owner)->hash = 0;
+        delete static_cast<JsonObjectBlock *>(owner)->text.exchange(nullptr);
+        return static_cast<JsonObjectBlock *>(owner)->members;
     }
 
-    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonObject> obj)
+    void JsonValue::resized(bool appended)
     {
-        if (obj.value.empty()) return out << "{}";
-        else
+        if (kind == Array) { auto & e = static_cast<JsonArrayBlock *>(owner)->elements; data = e.data(); size = e.size(); return; }
+        auto & block = *static_cast<JsonObjectBlock *>(owner);
+        data = block.members.data(); size = block.members.size();
+
+        // No other value refers to this block, so an index which no longer fits its members is simply dropped, to be rebuilt by the next lookup
+        auto index = block.index.load(std::memory_order_relaxed);
+        if (index && appended && indexCapacity(size) == indexCapacity(size - 1)) indexMember(index, block.members, size - 1);
+        else { delete[] index; block.index = nullptr; }
+    }
+
+    JsonValue & JsonValue::lend(JsonValue & val)
+    {
+        // Any memoized hash or cached text was dropped when this container was given contents of its own, and none is kept from now on
+        if (kind == Array) static_cast<JsonArrayBlock *>(owner)->lent = true;
+        else static_cast<JsonObjectBlock *>(owner)->lent = true;
+        return val;
+    }
+
+    void JsonValue::retain()
+    {
+        // A block which has lent references may still change through them, so a copy takes elements or members of its own, which share each of them with the
+        // original. Any of those which are lent in turn are copied likewise, so that changes made through a reference at any depth are never seen by the copy.
+        if (kind == Array && !cached && static_cast<JsonArrayBlock *>(owner)->lent)
         {
-            int space = obj.indent + obj.tabWidth, i = 0;
-            out << '{';
-            for (auto & kvp : obj.value)
+            auto block = new JsonArrayBlock(static_cast<JsonArrayBlock *>(owner)->elements);
+            owner = block; data = block->elements.data();
+        }
+        else if (kind == Object && static_cast<JsonObjectBlock *>(owner)->lent)
+        {
+            auto & shared = *static_cast<JsonObjectBlock *>(owner);
+            std::unique_ptr<JsonObjectBlock> block(new JsonObjectBlock(shared.members));
+            if (auto index = shared.index.load(std::memory_order_acquire)) // The copied members keep their positions, as in ownMembers()
             {
-                printEscaped(indent(out, space, i++), kvp.first) << ": " << tabbed(kvp.second, obj.tabWidth, space);
+                block->index = new uint32_t[indexCapacity(size)];
+                std::copy(index, index + indexCapacity(size), block->index.load(std::memory_order_relaxed));
             }
-            return indent(out, obj.indent) << '}';
+            owner = block.release(); data = static_cast<JsonObjectBlock *>(owner)->members.data();
         }
+        else ++owner->refs;
+    }
+
+    JsonValue & JsonValue::slot(size_t index)
+    {
+        auto & elements = ownElements();
+        if (index >= elements.size()) { elements.resize(index + 1); resized(); }
+        return elements[index];
+    }
+
+    JsonValue & JsonValue::slot(const char * key, size_t length, const JsonString * name)
+    {
+        auto & members = ownMembers();
+        if (auto kvp = find(key, length)) return const_cast<JsonValue &>(kvp->second);
+        members.emplace_back(name ? *name : JsonString(std::string(key, length)), JsonValue());
+        resized(true);
+        return members.back().second;
     }
 
-    std::ostream & operator << (std::ostream & out, tabbed_ref<JsonValue> val)
+    JsonValue & JsonValue::push(JsonValue value)
     {
-        if (val.value.isArray()) return out << tabbed(val.value.array(), val.tabWidth, val.indent);
-        else if (val.value.isObject()) return out << tabbed(val.value.object(), val.tabWidth, val.indent);
-        else return out << val.value;
+        auto & elements = ownElements();
+        elements.push_back(std::move(value));
+        resized();
+        return lend(elements.back());
     }
 
-    bool isJsonNumber(const std::string & num)
+    bool JsonValue::erase(size_t index)
+    {
+        if (index >= array().size()) return false;
+        auto & elements = ownElements();
+        elements.erase(elements.begin() + index);
+        resized();
+        return true;
+    }
+
+    bool JsonValue::erase(const char * key, size_t length)
+    {
+        auto kvp = find(key, length);
+        if (!kvp) return false;
+        auto position = kvp - object().begin();
+        auto & members = ownMembers();
+        members.erase(members.begin() + position);
+        resized();
+        return true;
+    }
+
+    void * JsonArena::allocate(size_t size, size_t alignment)
+    {
+        auto align = [alignment](char * p) { return reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(alignment - 1)); };
+        if (next && size <= static_cast<size_t>(limit - std::min(align(next), limit)))
+        {
+            auto first = align(next);
+            next = first + size;
+            return first;
+        }
+
+        // Give large allocations their own block, so that the remainder of the current block is not wasted
+        auto large = size + alignment > blockSize / 4;
+        auto n = large ? size + alignment : blockSize;
+        blocks.emplace_back(new char[n]);
+        bytes += n;
+        if (large) return align(blocks.back().get());
+        next = blocks.back().get();
+        limit = next + n;
+        return allocate(size, alignment);
+    }
+
+    bool isJsonNumber(const char * first, const char * last)
     {
     #ifdef __GNUC__
-        auto it=begin(num); if(it == end(num)) return false;                   // String cannot be empty
-        if(*it == '-') ++it; if(it == end(num)) return false;                  // Discard optional - at start of string
+        auto it=first; if(it == last) return false;                            // String cannot be empty
+        if(*it == '-') ++it; if(it == last) return false;                      // Discard optional - at start of string
 
         if(*it == '0') ++it;                                                   // Whole number part can be 0
-        else if(isdigit(*it)) { while(it != end(num) && isdigit(*it)) ++it; }  // or [1-9][0-9]*
+        else if(isdigit(*it)) { while(it != last && isdigit(*it)) ++it; }      // or [1-9][0-9]*
         else return false;                                                     // but anything else fails the match
-        if(it == end(num)) return true;                                        // Acceptable to stop here
+        if(it == last) return true;                                            // Acceptable to stop here
 
         if(*it == '.')                                                         // If there is a .
         {
-            ++it; if(it == end(num)) return false;                             // We need at least one more digit
-            while(it != end(num) && isdigit(*it)) ++it;                        // Skip all digits
-            if(it == end(num)) return true;                                    // Acceptable to stop here
+            ++it; if(it == last) return false;                                 // We need at least one more digit
+            while(it != last && isdigit(*it)) ++it;                            // Skip all digits
+            if(it == last) return true;                                        // Acceptable to stop here
         } 
 
         if(*it == 'e' || *it == 'E')                                           // If there is an e or an E
         {
-            ++it; if(it == end(num)) return false;                             // We need the exponent term
+            ++it; if(it == last) return false;                                 // We need the exponent term
             if(*it == '+' || *it == '-') ++it;                                 // Skip +/-
-            if(it == end(num)) return false;                                   // We still need the exponent term
-            while(it != end(num) && isdigit(*it)) ++it;                        // Skip all digits
-            if(it == end(num)) return true;                                    // Acceptable to stop here
+            if(it == last) return false;                                       // We still need the exponent term
+            while(it != last && isdigit(*it)) ++it;                            // Skip all digits
+            if(it == last) return true;                                        // Acceptable to stop here
         }
 
         return false;                                                          // Anything left over fails the match
     #else
         static const std::regex regex(R"(-?(0|([1-9][0-9]*))((\.[0-9]+)?)(((e|E)((\+|-)?)[0-9]+)?))");
-	    return std::regex_match(begin(num), end(num), regex);
+	    return std::regex_match(first, last, regex);
     #endif
     }
 
-    static uint16_t decode_hex(char ch) {
-        if (ch >= '0' && ch <= '9') return ch - '0';
-        if (ch >= 'A' && ch <= 'F') return 10 + ch - 'A';
-        if (ch >= 'a' && ch <= 'f') return 10 + ch - 'a';
-        throw JsonParseError(std::string("invalid hex digit: ") + ch);
-    }
+    bool isJsonNumber(const std::string & num) { return isJsonNumber(num.data(), num.data() + num.size()); }
 
-    static std::string decode_string(std::string::const_iterator first, std::string::const_iterator last)
+    // Decomposition of a JSON format number into mantissa * 10^exponent, retaining as many significant digits as fit in 64 bits
+    struct JsonDecimal
     {
-        if (std::any_of(first, last, iscntrl)) throw JsonParseError("control character found in string literal");
-        if (std::find(first, last, '\\') == last) return std::string(first, last); // No escape characters, use the string directly
-        std::string s; s.reserve(last - first); // Reserve enough memory to hold the entire string
-        for (; first < last; ++first)
+        bool negative, integral, truncated; // Integral if there was no fraction or exponent, truncated if any nonzero digits did not fit
+        uint64_t mantissa;
+        int exponent;
+
+        JsonDecimal(const char * first, const char * last) : negative(), integral(true), truncated(), mantissa(), exponent()
         {
-            if (*first != '\\') s.push_back(*first);
-            else switch (*(++first))
+            auto it = first;
+            if (it != last && *it == '-') { negative = true; ++it; }
+            for (; it != last && isdigit(*it); ++it) addDigit(*it - '0', 0);
+            if (it != last && *it == '.') for (integral = false, ++it; it != last && isdigit(*it); ++it) addDigit(*it - '0', -1);
+            if (it != last && (*it == 'e' || *it == 'E'))
             {
-            case '"': s.push_back('"'); break;
-            case '\\': s.push_back('\\'); break;
-            case '/': s.push_back('/'); break;
-            case 'b': s.push_back('\b'); break;
-            case 'f': s.push_back('\f'); break;
-            case 'n': s.push_back('\n'); break;
-            case 'r': s.push_back('\r'); break;
-            case 't': s.push_back('\t'); break;
-            case 'u':
-                if (first + 5 > last) throw JsonParseError("incomplete escape sequence: " + std::string(first - 1, last));
-                else
-                {
-                    uint16_t val = (decode_hex(first[1]) << 12) | (decode_hex(first[2]) << 8) | (decode_hex(first[3]) << 4) | decode_hex(first[4]);
-                    if (val < 0x80) s.push_back(static_cast<char>(val)); // ASCII codepoint, no translation needed
-                    else if (val < 0x800) // 2-byte UTF-8 encoding
-                    {
-                        s.push_back(0xC0 | ((val >> 6) & 0x1F)); // Leading byte: 5 content bits
-                        s.push_back(0x80 | ((val >> 0) & 0x3F)); // Continuation byte: 6 content bits
-                    }
-                    else // 3-byte UTF-8 encoding (16 content bits, sufficient to store all \uXXXX patterns)
-                    {
-                        s.push_back(0xE0 | ((val >> 12) & 0x0F)); // Leading byte: 4 content bits
-                        s.push_back(0x80 | ((val >> 6) & 0x3F)); // Continuation byte: 6 content bits
-                        s.push_back(0x80 | ((val >> 0) & 0x3F)); // Continuation byte: 6 content bits
-                    }
-                    first += 4;
-                }
-                break;
-            default: throw JsonParseError("invalid escape sequence");
+                integral = false;
+                bool negativeExponent = *++it == '-';
+                if (*it == '-' || *it == '+') ++it;
+                int n = 0;
+                for (; it != last && isdigit(*it); ++it) n = std::min(n * 10 + (*it - '0'), 100000); // Anything this large is already infinite or zero
+                exponent += negativeExponent ? -n : n;
             }
         }
-        return s;
+
+        void addDigit(int digit, int shift)
+        {
+            if (mantissa < UINT64_MAX / 10 || (mantissa == UINT64_MAX / 10 && digit <= static_cast<int>(UINT64_MAX % 10))) { mantissa = mantissa * 10 + digit; exponent += shift; }
+            else { exponent += shift + 1; truncated |= digit != 0; }
+        }
+
+        template<class T> bool fastPath(T & value, uint64_t maxMantissa, int maxExponent, const T * powers) const // Exact when both operands are exactly representable
+        {
+            if (truncated || mantissa > maxMantissa || exponent < -maxExponent || exponent > maxExponent) return false;
+            value = exponent < 0 ? static_cast<T>(mantissa) / powers[-exponent] : static_cast<T>(mantissa) * powers[exponent];
+            if (negative) value = -value;
+            return true;
+        }
+    };
+
+    // Fall back on the C library for numbers which cannot be converted exactly, after translating the decimal point to that of the current locale
+    template<class T> static T convertWithLocale(const char * first, const char * last, T (* convert)(const char *, char **))
+    {
+        char buffer[64];
+        std::string copy;
+        char * s = buffer;
+        if (last - first >= static_cast<ptrdiff_t>(sizeof(buffer))) { copy.resize(last - first + 1); s = &copy[0]; }
+        auto point = *localeconv()->decimal_point;
+        *std::replace_copy(first, last, s, '.', point) = '\0';
+        return convert(s, nullptr);
+    }
+
+    static const double doublePowers[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    static const float floatPowers[] = {1e0f,1e1f,1e2f,1e3f,1e4f,1e5f,1e6f,1e7f,1e8f,1e9f,1e10f};
+
+    bool JsonValue::numberAs(double & n) const
+    {
+        switch (kind == Number ? cached : Uncached)
+        {
+        case Integer: n = static_cast<double>(integer); return true;
+        case Natural: n = static_cast<double>(natural); return true;
+        case Real: case Single: n = real; return true;
+        default:
+            if (!isNumber()) return false;
+            if (!JsonDecimal(chars(), chars() + digits).fastPath(n, 1ULL << 53, 22, doublePowers)) n = convertWithLocale(chars(), chars() + digits, strtod);
+            return true;
+        }
     }
 
-    struct JsonToken { char type; std::string value; JsonToken(char type, std::string value = std::string()) : type(type), value(move(value)) {} };
+    bool JsonValue::numberAs(float & n) const
+    {
+        switch (kind == Number ? cached : Uncached)
+        {
+        case Integer: n = static_cast<float>(integer); return true;
+        case Natural: n = static_cast<float>(natural); return true;
+        case Real: case Single: n = static_cast<float>(real); return true;
+        default:
+            if (!isNumber()) return false;
+            if (!JsonDecimal(chars(), chars() + digits).fastPath(n, 1ULL << 24, 10, floatPowers)) n = convertWithLocale(chars(), chars() + digits, strtof);
+            return true;
+        }
+    }
 
-    struct JsonParseState
+    bool JsonValue::numberAs(int64_t & n) const
     {
-        std::vector<JsonToken>::iterator it, last;
+        if (kind == Number && cached == Integer) { n = integer; return true; }
+        if (kind == Number && cached == Natural) { n = static_cast<int64_t>(natural); return natural <= INT64_MAX; }
+        if (!isNumber()) return false;
+        JsonDecimal d(chars(), chars() + digits); // Numbers without text hold a cached real
+        if (digits && d.integral && !d.truncated && d.exponent == 0)
+        {
+            if (d.mantissa > (d.negative ? 1ULL << 63 : static_cast<uint64_t>(INT64_MAX))) return false;
+            n = d.negative ? static_cast<int64_t>(0 - d.mantissa) : static_cast<int64_t>(d.mantissa);
+            return true;
+        }
+        double r;
+        if (!numberAs(r) || !(r >= -9223372036854775808.0 && r < 9223372036854775808.0)) return false;
+        n = static_cast<int64_t>(r);
+        return true;
+    }
 
-        bool matchAndDiscard(char type) { if (it->type != type) return false; ++it; return true; }
-        void discardExpected(char type, const char * what) { if (!matchAndDiscard(type)) throw JsonParseError(std::string("Syntax error: Expected ") + what); }
+    bool JsonValue::numberAs(uint64_t & n) const
+    {
+        if (kind == Number && cached == Natural) { n = natural; return true; }
+        if (kind == Number && cached == Integer) { n = static_cast<uint64_t>(integer); return integer >= 0; }
+        if (!isNumber()) return false;
+        JsonDecimal d(chars(), chars() + digits); // Numbers without text hold a cached real
+        if (digits && d.integral && !d.truncated && d.exponent == 0)
+        {
+            if (d.negative && d.mantissa) return false;
+            n = d.mantissa;
+            return true;
+        }
+        double r;
+        if (!numberAs(r) || !(r > -1.0 && r < 18446744073709551616.0)) return false;
+        n = static_cast<uint64_t>(r);
+        return true;
+    }
 
-        JsonValue parseValue()
+    void JsonValue::cacheNumber()
+    {
+        if (!isNumber() || cached) return;
+        JsonDecimal d(chars(), chars() + digits);
+        if (d.integral && !d.truncated && d.exponent == 0 && (!d.negative || d.mantissa <= 1ULL << 63)) // Keep integers exact where possible
         {
-            auto token = it++;
-            switch (token->type)
-            {
-            case 'n': return nullptr;
-            case 'f': return false;
-            case 't': return true;
-            case '"': return token->value;
-            case '#': return JsonValue::fromNumber(token->value);
-            case '[':
-                if (matchAndDiscard(']')) return JsonArray{};
-                else
-                {
-                    JsonArray arr;
-                    while (true)
-                    {
-                        arr.push_back(parseValue());
-                        if (matchAndDiscard(']')) return arr;
-                        discardExpected(',', ", or ]");
-                    }
-                }
-            case '{':
-                if (matchAndDiscard('}')) return JsonObject{};
-                else
-                {
-                    JsonObject obj;
-                    while (true)
-                    {
-                        auto name = move(it->value);
-                        discardExpected('"', "string");
-                        discardExpected(':', ":");
-                        obj.emplace_back(move(name), parseValue());
-                        if (matchAndDiscard('}')) { return obj; }
-                        discardExpected(',', ", or }");
-                    }
-                }
-            default: throw JsonParseError("Expected value");
-            }
+            if (d.negative || d.mantissa <= static_cast<uint64_t>(INT64_MAX)) numberAs(integer), cached = Integer;
+            else natural = d.mantissa, cached = Natural;
         }
-    };
+        else numberAs(real), cached = Real;
+    }
 
-    std::vector<JsonToken> jsonTokensFrom(const std::string & text)
+    // Binary floating point number f * 2^e with a 64-bit significand, as used by Loitsch's Grisu algorithms
+    struct DiyFp
     {
-        std::vector<JsonToken> tokens;
-        auto it = begin(text);
-        while (true)
+        uint64_t f;
+        int e;
+
+        DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+        DiyFp operator - (const DiyFp & r) const { return DiyFp(f - r.f, e); } // Both operands must have the same exponent
+        DiyFp operator * (const DiyFp & r) const // Upper 64 bits of the 128-bit product, rounded
         {
-            it = std::find_if_not(it, end(text), isspace); // Skip whitespace
-            if (it == end(text))
-            {
-                tokens.emplace_back('$');
-                return tokens;
-            }
-            switch (*it)
-            {
-            case '[': case ']': case ',':
-            case '{': case '}': case ':':
-                tokens.push_back({ *it++ });
-                break;
-            case '"':
-                {
-                    auto it2 = ++it;
-                    for (; it2 < end(text); ++it2)
-                    {
-                        if (*it2 == '"') break;
-                        if (*it2 == '\\') ++it2;
-                    }
-                    if (it2 < end(text))
-                    {
-                        tokens.emplace_back('"', decode_string(it, it2));
-                        it = it2 + 1;
-                    }
-                    else throw JsonParseError("String missing closing quote");
-                }
-                break;
-            case '-': case '0': case '1': case '2':
-            case '3': case '4': case '5': case '6':
-            case '7': case '8': case '9':
-                {
-                    auto it2 = std::find_if_not(it, end(text), [](char ch) { return isalnum(ch) || ch == '+' || ch == '-' || ch == '.'; });
-                    auto num = std::string(it, it2);
-                    if (!isJsonNumber(num)) throw JsonParseError("Invalid number: " + num);
-                    tokens.emplace_back('#', move(num));
-                    it = it2;
-                }
-                break;
-            default:
-                if (isalpha(*it))
-                {
-                    auto it2 = std::find_if_not(it, end(text), isalpha);
-                    if (std::equal(it, it2, "true")) tokens.emplace_back('t');
-                    else if (std::equal(it, it2, "false")) tokens.emplace_back('f');
-                    else if (std::equal(it, it2, "null")) tokens.emplace_back('n');
-                    else throw JsonParseError("Invalid token: " + std::string(it, it2));
-                    it = it2;
-                }
-                else throw JsonParseError("Invalid character: \'" + std::string(1, *it) + '"');
-            }
+            uint64_t a = f >> 32, b = f & 0xFFFFFFFF, c = r.f >> 32, d = r.f & 0xFFFFFFFF;
+            uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+            uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF) + (1ULL << 31);
+            return DiyFp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), e + r.e + 64);
+        }
+        DiyFp normalized() const
+        {
+            auto r = *this;
+            while (!(r.f >> 56)) { r.f <<= 8; r.e -= 8; }
+            while (!(r.f >> 63)) { r.f <<= 1; r.e -= 1; }
+            return r;
         }
+    };
+
+    // Find the boundaries of the interval of real numbers which round to value, a positive finite float or double, so that minus, v and plus all share the exponent of plus
+    template<class T, class Bits> static void findBoundaries(T value, DiyFp & minus, DiyFp & v, DiyFp & plus)
+    {
+        const int precision = std::numeric_limits<T>::digits, bias = std::numeric_limits<T>::max_exponent - 1 + precision - 1;
+        const uint64_t hidden = 1ULL << (precision - 1);
+        Bits bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint64_t exponent = bits >> (precision - 1), significand = bits & (hidden - 1);
+        DiyFp w = exponent ? DiyFp(significand + hidden, static_cast<int>(exponent) - bias) : DiyFp(significand, 1 - bias);
+        plus = DiyFp(2 * w.f + 1, w.e - 1).normalized();
+        minus = significand == 0 && exponent > 1 ? DiyFp(4 * w.f - 1, w.e - 2) : DiyFp(2 * w.f - 1, w.e - 1); // The gap below a power of two is half as wide
+        minus = DiyFp(minus.f << (minus.e - plus.e), plus.e);
+        v = w.normalized();
     }
 
-    JsonValue jsonFrom(const std::string & text)
+    // Normalized approximations of 10^k for every eighth k from -300 to 324, chosen so that scaling any double's boundaries by one of them yields an exponent in [-60, -32]
+    struct CachedPower { uint64_t f; int e, k; };
+    static const CachedPower & cachedPowerFor(int e)
     {
-        auto tokens = jsonTokensFrom(text);
-        JsonParseState p = { begin(tokens), end(tokens) };
-        auto val = p.parseValue();
-        p.discardExpected('$', "end-of-stream");
-        return val;
+        static const CachedPower powers[] = {
+            { 0xAB70FE17C79AC6CAULL, -1060, -300 }, { 0xFF77B1FCBEBCDC4FULL, -1034, -292 }, { 0xBE5691EF416BD60CULL, -1007, -284 },
+            { 0x8DD01FAD907FFC3CULL,  -980, -276 }, { 0xD3515C2831559A83ULL,  -954, -268 }, { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+            { 0xEA9C227723EE8BCBULL,  -901, -252 }, { 0xAECC49914078536DULL,  -874, -244 }, { 0x823C12795DB6CE57ULL,  -847, -236 },
+            { 0xC21094364DFB5637ULL,  -821, -228 }, { 0x9096EA6F3848984FULL,  -794, -220 }, { 0xD77485CB25823AC7ULL,  -768, -212 },
+            { 0xA086CFCD97BF97F4ULL,  -741, -204 }, { 0xEF340A98172AACE5ULL,  -715, -196 }, { 0xB23867FB2A35B28EULL,  -688, -188 },
+            { 0x84C8D4DFD2C63F3BULL,  -661, -180 }, { 0xC5DD44271AD3CDBAULL,  -635, -172 }, { 0x936B9FCEBB25C996ULL,  -608, -164 },
+            { 0xDBAC6C247D62A584ULL,  -582, -156 }, { 0xA3AB66580D5FDAF6ULL,  -555, -148 }, { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+            { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 }, { 0x87625F056C7C4A8BULL,  -475, -124 }, { 0xC9BCFF6034C13053ULL,  -449, -116 },
+            { 0x964E858C91BA2655ULL,  -422, -108 }, { 0xDFF9772470297EBDULL,  -396, -100 }, { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+            { 0xF8A95FCF88747D94ULL,  -343,  -84 }, { 0xB94470938FA89BCFULL,  -316,  -76 }, { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+            { 0xCDB02555653131B6ULL,  -263,  -60 }, { 0x993FE2C6D07B7FACULL,  -236,  -52 }, { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+            { 0xAA242499697392D3ULL,  -183,  -36 }, { 0xFD87B5F28300CA0EULL,  -157,  -28 }, { 0xBCE5086492111AEBULL,  -130,  -20 },
+            { 0x8CBCCC096F5088CCULL,  -103,  -12 }, { 0xD1B71758E219652CULL,   -77,   -4 }, { 0x9C40000000000000ULL,   -50,    4 },
+            { 0xE8D4A51000000000ULL,   -24,   12 }, { 0xAD78EBC5AC620000ULL,     3,   20 }, { 0x813F3978F8940984ULL,    30,   28 },
+            { 0xC097CE7BC90715B3ULL,    56,   36 }, { 0x8F7E32CE7BEA5C70ULL,    83,   44 }, { 0xD5D238A4ABE98068ULL,   109,   52 },
+            { 0x9F4F2726179A2245ULL,   136,   60 }, { 0xED63A231D4C4FB27ULL,   162,   68 }, { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+            { 0x83C7088E1AAB65DBULL,   216,   84 }, { 0xC45D1DF942711D9AULL,   242,   92 }, { 0x924D692CA61BE758ULL,   269,  100 },
+            { 0xDA01EE641A708DEAULL,   295,  108 }, { 0xA26DA3999AEF774AULL,   322,  116 }, { 0xF209787BB47D6B85ULL,   348,  124 },
+            { 0xB454E4A179DD1877ULL,   375,  132 }, { 0x865B86925B9BC5C2ULL,   402,  140 }, { 0xC83553C5C8965D3DULL,   428,  148 },
+            { 0x952AB45CFA97A0B3ULL,   455,  156 }, { 0xDE469FBD99A05FE3ULL,   481,  164 }, { 0xA59BC234DB398C25ULL,   508,  172 },
+            { 0xF6C69A72A3989F5CULL,   534,  180 }, { 0xB7DCBF5354E9BECEULL,   561,  188 }, { 0x88FCF317F22241E2ULL,   588,  196 },
+            { 0xCC20CE9BD35C78A5ULL,   614,  204 }, { 0x98165AF37B2153DFULL,   641,  212 }, { 0xE2A0B5DC971F303AULL,   667,  220 },
+            { 0xA8D9D1535CE3B396ULL,   694,  228 }, { 0xFB9B7CD9A4A7443CULL,   720,  236 }, { 0xBB764C4CA7A44410ULL,   747,  244 },
+            { 0x8BAB8EEFB6409C1AULL,   774,  252 }, { 0xD01FEF10A657842CULL,   800,  260 }, { 0x9B10A4E5E9913129ULL,   827,  268 },
+            { 0xE7109BFBA19C0C9DULL,   853,  276 }, { 0xAC2820D9623BF429ULL,   880,  284 }, { 0x80444B5E7AA7CF85ULL,   907,  292 },
+            { 0xBF21E44003ACDD2DULL,   933,  300 }, { 0x8E679C2F5E44FF8FULL,   960,  308 }, { 0xD433179D9C8CB841ULL,   986,  316 },
+            { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+        };
+        int f = -60 - e - 1, k = (f * 78913) / (1 << 18) + (f > 0); // ceil(f * log10(2))
+        return powers[(300 + k + 7) / 8];
+    }
+
+    // Move the last of the digits toward w, which lies distTooHigh below tooHigh, while they stay inside the unsafe interval, and report whether the result is
+    // certainly the closest shortest number inside the real interval. Both w and the interval's bounds are only known to within unit, so this is Grisu3's test.
+    static bool roundWeed(char * digits, int length, uint64_t distTooHigh, uint64_t unsafe, uint64_t rest, uint64_t tenKappa, uint64_t unit)
+    {
+        uint64_t smallDist = distTooHigh - unit, bigDist = distTooHigh + unit;
+        while (rest < smallDist && unsafe - rest >= tenKappa && (rest + tenKappa < smallDist || smallDist - rest >= rest + tenKappa - smallDist))
+        {
+            --digits[length - 1];
+            rest += tenKappa;
+        }
+        if (rest < bigDist && unsafe - rest >= tenKappa && (rest + tenKappa < bigDist || bigDist - rest > rest + tenKappa - bigDist)) return false;
+        return 2 * unit <= rest && rest <= unsafe - 4 * unit;
     }
+
+    // Generate the shortest digits which lie between minus and plus, and are closest to v. Returns false in the rare cases where the rounding of the scaled
+    // boundaries leaves the answer in doubt, after which generateExactDigits must be used instead.
+    static bool generateDigits(char * digits, int & length, int & exponent, DiyFp minus, DiyFp v, DiyFp plus)
+    {
+        auto & power = cachedPowerFor(plus.e);
+        DiyFp c(power.f, power.e), w = v * c, tooLow = minus * c, tooHigh = plus * c;
+        uint64_t unit = 1; // Each product is within half a unit of the exact value
+        tooLow.f -= unit; tooHigh.f += unit;
+        exponent = -power.k;
+
+        uint64_t unsafe = (tooHigh - tooLow).f, one = 1ULL << -w.e;
+        auto integral = static_cast<uint32_t>(tooHigh.f >> -w.e);
+        uint64_t fraction = tooHigh.f & (one - 1);
+        uint32_t pow10 = 1;
+        int n = 1;
+        while (integral / 10 >= pow10) { pow10 *= 10; ++n; }
+        for (; n > 0; pow10 /= 10)
+        {
+            digits[length++] = static_cast<char>('0' + integral / pow10);
+            integral %= pow10;
+            --n;
+            uint64_t rest = (static_cast<uint64_t>(integral) << -w.e) + fraction;
+            if (rest < unsafe) { exponent += n; return roundWeed(digits, length, (tooHigh - w).f, unsafe, rest, static_cast<uint64_t>(pow10) << -w.e, unit); }
+        }
+        for (;;)
+        {
+            fraction *= 10;
+            unit *= 10;
+            unsafe *= 10;
+            digits[length++] = static_cast<char>('0' + (fraction >> -w.e));
+            fraction &= one - 1;
+            --exponent;
+            if (fraction < unsafe) return roundWeed(digits, length, (tooHigh - w).f * unit, unsafe, fraction, one, unit);
+        }
+    }
+
+    // Unsigned integer of up to 1280 bits, enough to hold any double scaled by a power of ten as generateExactDigits needs
+    struct BigNumber
+    {
+        uint32_t words[40];
+        int size;
+
+        explicit BigNumber(uint64_t n) : size(0) { for (; n; n >>= 32) words[size++] = static_cast<uint32_t>(n); }
+
+        void shiftLeft(int bits)
+        {
+            int whole = bits / 32, part = bits % 32;
+            if (!size) return;
+            words[size] = 0;
+            if (part) for (int i = size; i > 0; --i) words[i] = words[i] << part | words[i - 1] >> (32 - part);
+            words[0] <<= part;
+            size += words[size] ? 1 : 0;
+            std::copy_backward(words, words + size, words + size + whole);
+            std::fill_n(words, whole, 0);
+            size += whole;
+        }
+        void multiply(uint32_t n)
+        {
+            uint64_t carry = 0;
+            for (int i = 0; i < size; ++i) { carry += static_cast<uint64_t>(words[i]) * n; words[i] = static_cast<uint32_t>(carry); carry >>= 32; }
+            if (carry) words[size++] = static_cast<uint32_t>(carry);
+        }
+        void multiplyPow10(int n) { for (; n >= 9; n -= 9) multiply(1000000000); static const uint32_t small[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 }; multiply(small[n]); }
+        void subtract(const BigNumber & r) // r must not be greater than this number
+        {
+            int64_t borrow = 0;
+            for (int i = 0; i < size; ++i) { borrow += static_cast<int64_t>(words[i]) - (i < r.size ? r.words[i] : 0); words[i] = static_cast<uint32_t>(borrow); borrow >>= 32; }
+            while (size && !words[size - 1]) --size;
+        }
+        BigNumber operator + (const BigNumber & r) const
+        {
+            BigNumber sum(0);
+            uint64_t carry = 0;
+            for (int i = 0; i < std::max(size, r.size); ++i) { carry += static_cast<uint64_t>(i < size ? words[i] : 0) + (i < r.size ? r.words[i] : 0); sum.words[sum.size++] = static_cast<uint32_t>(carry); carry >>= 32; }
+            if (carry) sum.words[sum.size++] = static_cast<uint32_t>(carry);
+            return sum;
+        }
+        int compare(const BigNumber & r) const
+        {
+            if (size != r.size) return size < r.size ? -1 : 1;
+            for (int i = size - 1; i >= 0; --i) if (words[i] != r.words[i]) return words[i] < r.words[i] ? -1 : 1;
+            return 0;
+        }
+    };
+
+    // Generate the shortest digits which read back as value, a positive finite float or double, and are closest to it, using exact arithmetic as described by
+    // Steele and White. Much slower than generateDigits, but only needed when that cannot decide. Boundaries read back as value when its significand is even.
+    template<class T, class Bits> static void generateExactDigits(char * digits, int & length, int & exponent, T value)
+    {
+        const int precision = std::numeric_limits<T>::digits, bias = std::numeric_limits<T>::max_exponent - 1 + precision - 1;
+        const uint64_t hidden = 1ULL << (precision - 1);
+        Bits bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint64_t biased = bits >> (precision - 1), f = bits & (hidden - 1);
+        int e = biased ? static_cast<int>(biased) - bias : 1 - bias;
+        bool closerBelow = f == 0 && biased > 1, even = (f & 1) == 0;
+        if (biased) f += hidden;
+
+        // value is r / s, and the gaps to its neighbours are 2 * plus / s above and 2 * minus / s below
+        BigNumber r(f << (closerBelow ? 2 : 1)), s(closerBelow ? 4 : 2), plus(closerBelow ? 2 : 1), minus(1);
+        if (e >= 0) { r.shiftLeft(e); plus.shiftLeft(e); minus.shiftLeft(e); }
+        else s.shiftLeft(-e);
+
+        int bitLength = 0;
+        while (f >> bitLength) ++bitLength;
+        int k = static_cast<int>(std::ceil((e + bitLength - 1) * 0.30102999566398114 - 1e-10)); // 10^k exceeds value, or falls short of it by one power
+        if (k >= 0) s.multiplyPow10(k);
+        else { r.multiplyPow10(-k); plus.multiplyPow10(-k); minus.multiplyPow10(-k); }
+        if ((r + plus).compare(s) >= (even ? 0 : 1)) { s.multiply(10); ++k; }
+
+        for (;;)
+        {
+            r.multiply(10); plus.multiply(10); minus.multiply(10);
+            char digit = '0';
+            while (r.compare(s) >= 0) { r.subtract(s); ++digit; }
+            bool low = r.compare(minus) < (even ? 1 : 0), high = (r + plus).compare(s) >= (even ? 0 : 1);
+            digits[length++] = digit;
+            if (low || high)
+            {
+                int half = (r + r).compare(s); // Of two digits equally close to value, choose the even one
+                if (high && (!low || half > 0 || (half == 0 && digit % 2))) ++digits[length - 1];
+                break;
+            }
+        }
+        exponent = k - length;
+    }
+
+    // Lay out digits * 10^exponent as a JSON number, in positional notation unless that would need many zeros
+    static char * formatDecimal(char * out, const char * digits, int length, int exponent)
+    {
+        int point = length + exponent;
+        if (length <= point && point <= 21)
+        {
+            out = std::copy(digits, digits + length, out);
+            return std::fill_n(out, point - length, '0');
+        }
+        if (0 < point && point <= 21)
+        {
+            out = std::copy(digits, digits + point, out);
+            *out++ = '.';
+            return std::copy(digits + point, digits + length, out);
+        }
+        if (-6 < point && point <= 0)
+        {
+            *out++ = '0';
+            *out++ = '.';
+            out = std::fill_n(out, -point, '0');
+            return std::copy(digits, digits + length, out);
+        }
+        *out++ = digits[0];
+        if (length > 1) { *out++ = '.'; out = std::copy(digits + 1, digits + length, out); }
+        *out++ = 'e';
+        *out++ = point > 0 ? '+' : '-';
+        return formatJsonNumber(out, static_cast<uint64_t>(point > 0 ? point - 1 : 1 - point));
+    }
+
+    template<class T, class Bits> static char * formatShortest(char * out, T n)
+    {
+        if (!std::isfinite(n)) return std::copy_n("null", 4, out);
+        if (std::signbit(n)) { *out++ = '-'; n = -n; }
+        if (n == 0) { *out++ = '0'; return out; }
+        DiyFp minus(0, 0), v(0, 0), plus(0, 0);
+        findBoundaries<T, Bits>(n, minus, v, plus);
+        char digits[20];
+        int length = 0, exponent = 0;
+        if (!generateDigits(digits, length, exponent, minus, v, plus)) { length = 0; generateExactDigits<T, Bits>(digits, length, exponent, n); }
+        return formatDecimal(out, digits, length, exponent);
+    }
+
+    char * formatJsonNumber(char * buffer, float n) { return formatShortest<float, uint32_t>(buffer, n); }
+    char * formatJsonNumber(char * buffer, double n) { return formatShortest<double, uint64_t>(buffer, n); }
+    char * formatJsonNumber(char * buffer, int64_t n) { if (n < 0) *buffer++ = '-'; return formatJsonNumber(buffer, n < 0 ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n)); }
+    char * formatJsonNumber(char * buffer, uint64_t n)
+    {
+        char digits[20];
+        int length = 0;
+        do digits[length++] = static_cast<char>('0' + n % 10); while (n /= 10);
+        return std::reverse_copy(digits, digits + length, buffer);
+    }
+
+    array_ref<char> JsonValue::numberText(char * buffer) const
+    {
+        if (digits) return{ chars(), chars() + digits };
+        switch (cached)
+        {
+        case Integer: return{ buffer, formatJsonNumber(buffer, integer) };
+        case Natural: return{ buffer, formatJsonNumber(buffer, natural) };
+        case Real: return{ buffer, formatJsonNumber(buffer, real) };
+        case Single: return{ buffer, formatJsonNumber(buffer, static_cast<float>(real)) };
+        default: return{ buffer, buffer };
+        }
+    }
+
+    JsonString JsonValue::contents() const
+    {
+        if (kind == String) return JsonString(chars(), size, owner);
+        if (kind != Number) return JsonString();
+        if (digits) return JsonString(chars(), digits, owner);
+        char buffer[32];
+        auto text = numberText(buffer);
+        return JsonString(std::string(text.begin(), text.end()));
+    }
+
+    static uint16_t decode_hex(char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'A' && ch <= 'F') return 10 + ch - 'A';
+        if (ch >= 'a' && ch <= 'f') return 10 + ch - 'a';
+        throw JsonParseError(std::string("invalid hex digit: ") + ch);
+    }
+
+    static void decode_string(const char * first, const char * last, std::string & s)
+    {
+        s.clear(); s.reserve(last - first); // Reserve enough memory to hold the entire string
+        for (; first < last; ++first)
+        {
+            if (*first != '\\') s.push_back(*first);
+            else switch (*(++first))
+            {
+            case '"': s.push_back('"'); break;
+            case '\\': s.push_back('\\'); break;
+            case '/': s.push_back('/'); break;
+            case 'b': s.push_back('\b'); break;
+            case 'f': s.push_back('\f'); break;
+            case 'n': s.push_back('\n'); break;
+            case 'r': s.push_back('\r'); break;
+            case 't': s.push_back('\t'); break;
+            case 'u':
+                if (first + 5 > last) throw JsonParseError("incomplete escape sequence: " + std::string(first - 1, last));
+                else
+                {
+                    uint32_t val = (decode_hex(first[1]) << 12) | (decode_hex(first[2]) << 8) | (decode_hex(first[3]) << 4) | decode_hex(first[4]);
+                    first += 4;
+                    if (val >= 0xD800 && val < 0xDC00 && last - first > 6 && first[1] == '\\' && first[2] == 'u') // Surrogate pair encoding a codepoint beyond U+FFFF
+                    {
+                        uint32_t low = (decode_hex(first[3]) << 12) | (decode_hex(first[4]) << 8) | (decode_hex(first[5]) << 4) | decode_hex(first[6]);
+                        if (low >= 0xDC00 && low < 0xE000) { val = 0x10000 + ((val - 0xD800) << 10) + (low - 0xDC00); first += 6; }
+                    }
+                    if (val >= 0xD800 && val < 0xE000) val = 0xFFFD; // Unpaired surrogates cannot be encoded as UTF-8, so become replacement characters
+                    if (val < 0x80) s.push_back(static_cast<char>(val)); // ASCII codepoint, no translation needed
+                    else if (val < 0x800) // 2-byte UTF-8 encoding
+                    {
+                        s.push_back(0xC0 | ((val >> 6) & 0x1F)); // Leading byte: 5 content bits
+                        s.push_back(0x80 | ((val >> 0) & 0x3F)); // Continuation byte: 6 content bits
+                    }
+                    else if (val < 0x10000) // 3-byte UTF-8 encoding
+                    {
+                        s.push_back(0xE0 | ((val >> 12) & 0x0F)); // Leading byte: 4 content bits
+                        s.push_back(0x80 | ((val >> 6) & 0x3F)); // Continuation byte: 6 content bits
+                        s.push_back(0x80 | ((val >> 0) & 0x3F)); // Continuation byte: 6 content bits
+                    }
+                    else // 4-byte UTF-8 encoding
+                    {
+                        s.push_back(0xF0 | ((val >> 18) & 0x07)); // Leading byte: 3 content bits
+                        s.push_back(0x80 | ((val >> 12) & 0x3F)); // Continuation byte: 6 content bits
+                        s.push_back(0x80 | ((val >> 6) & 0x3F)); // Continuation byte: 6 content bits
+                        s.push_back(0x80 | ((val >> 0) & 0x3F)); // Continuation byte: 6 content bits
+                    }
+                }
+                break;
+            default: throw JsonParseError("invalid escape sequence");
+            }
+        }
+    }
+
+#ifdef COPPER_JSON_SIMD
+    // Classifies a block of COPPER_JSON_SIMD characters at once, producing a bit mask with one bit per character
+    struct JsonChars
+    {
+    #if COPPER_JSON_SIMD == 32
+        typedef __m256i Block;
+        static Block load(const char * p) { return _mm256_loadu_si256(reinterpret_cast<const Block *>(p)); }
+        static Block splat(uint8_t ch) { return _mm256_set1_epi8(static_cast<char>(ch)); }
+        static Block equal(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+        static Block min(Block a, Block b) { return _mm256_min_epu8(a, b); }
+        static Block sub(Block a, Block b) { return _mm256_sub_epi8(a, b); }
+        static Block either(Block a, Block b) { return _mm256_or_si256(a, b); }
+        static uint32_t mask(Block a) { return static_cast<uint32_t>(_mm256_movemask_epi8(a)); }
+    #else
+        typedef __m128i Block;
+        static Block load(const char * p) { return _mm_loadu_si128(reinterpret_cast<const Block *>(p)); }
+        static Block splat(uint8_t ch) { return _mm_set1_epi8(static_cast<char>(ch)); }
+        static Block equal(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+        static Block min(Block a, Block b) { return _mm_min_epu8(a, b); }
+        static Block sub(Block a, Block b) { return _mm_sub_epi8(a, b); }
+        static Block either(Block a, Block b) { return _mm_or_si128(a, b); }
+        static uint32_t mask(Block a) { return static_cast<uint32_t>(_mm_movemask_epi8(a)); }
+    #endif
+        Block chars;
+
+        explicit JsonChars(const char * p) : chars(load(p)) {}
+
+        Block is(uint8_t ch) const { return equal(chars, splat(ch)); }
+        Block atMost(uint8_t ch) const { return equal(min(chars, splat(ch)), chars); } // Unsigned comparison
+        Block within(uint8_t lo, uint8_t hi) const { auto offset = sub(chars, splat(lo)); return equal(min(offset, splat(hi - lo)), offset); }
+
+        uint32_t whitespace() const { return mask(either(is(' '), within('\t', '\r'))); }
+        uint32_t special() const { return mask(either(either(is('"'), is('\\')), either(atMost(0x1F), is(0x7F)))) | mask(chars); } // Quotes, backslashes, control characters and non-ASCII characters
+        uint32_t quoting() const { return mask(either(is('"'), is('\\'))); } // Quotes and backslashes
+        uint32_t structural() const { return mask(either(either(is('"'), either(is('['), is(']'))), either(is('{'), is('}')))); } // Quotes and brackets
+    };
+
+    static int lowestBit(uint32_t mask)
+    {
+    #ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+    #else
+        return __builtin_ctz(mask);
+    #endif
+    }
+#endif
+
+    // First character at or after it which is not whitespace, or last
+    static const char * skipWhitespace(const char * it, const char * last)
+    {
+        if (it == last || static_cast<uint8_t>(*it) > ' ') return it; // Most values are separated by at most one space, so check for none before vectorizing
+    #ifdef COPPER_JSON_SIMD
+        for (; last - it >= COPPER_JSON_SIMD; it += COPPER_JSON_SIMD)
+        {
+            auto mask = JsonChars(it).whitespace() ^ static_cast<uint32_t>((1ULL << COPPER_JSON_SIMD) - 1);
+            if (mask) return it + lowestBit(mask);
+        }
+    #endif
+        while (it != last && isspace(static_cast<uint8_t>(*it))) ++it;
+        return it;
+    }
+
+    // First character at or after it which may end or need checking within a string literal: a quote, a backslash, a control character or a non-ASCII character, or last
+    static const char * findSpecial(const char * it, const char * last)
+    {
+    #ifdef COPPER_JSON_SIMD
+        for (; last - it >= COPPER_JSON_SIMD; it += COPPER_JSON_SIMD)
+        {
+            auto mask = JsonChars(it).special();
+            if (mask) return it + lowestBit(mask);
+        }
+    #endif
+        for (; it != last; ++it)
+        {
+            auto ch = static_cast<uint8_t>(*it);
+            if (ch == '"' || ch == '\\' || ch < 0x20 || ch >= 0x7F) break;
+        }
+        return it;
+    }
+
+    // First character at or after it which is a quote or a backslash, or last
+    static const char * findQuoting(const char * it, const char * last)
+    {
+    #ifdef COPPER_JSON_SIMD
+        for (; last - it >= COPPER_JSON_SIMD; it += COPPER_JSON_SIMD)
+        {
+            auto mask = JsonChars(it).quoting();
+            if (mask) return it + lowestBit(mask);
+        }
+    #endif
+        for (; it != last; ++it) if (*it == '"' || *it == '\\') break;
+        return it;
+    }
+
+    // First character at or after it which is a quote or a bracket, or last
+    static const char * findStructural(const char * it, const char * last)
+    {
+    #ifdef COPPER_JSON_SIMD
+        for (; last - it >= COPPER_JSON_SIMD; it += COPPER_JSON_SIMD)
+        {
+            auto mask = JsonChars(it).structural();
+            if (mask) return it + lowestBit(mask);
+        }
+    #endif
+        for (; it != last; ++it) if (*it == '"' || *it == '[' || *it == ']' || *it == '{' || *it == '}') break;
+        return it;
+    }
+
+    // End of the well-formed UTF-8 sequence starting at it, or nullptr if it is malformed, overlong, a surrogate, or beyond U+10FFFF
+    static const char * skipUtf8(const char * it, const char * last)
+    {
+        auto byte = [&](ptrdiff_t i) { return static_cast<uint8_t>(it[i]); };
+        auto lead = byte(0);
+        int n = lead < 0x80 ? 1 : lead < 0xC2 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 0;
+        if (n == 0 || last - it < n) return nullptr;
+        for (int i = 1; i < n; ++i) if ((byte(i) & 0xC0) != 0x80) return nullptr;
+        if (lead == 0xE0 && byte(1) < 0xA0) return nullptr; // Overlong
+        if (lead == 0xED && byte(1) > 0x9F) return nullptr; // Surrogate
+        if (lead == 0xF0 && byte(1) < 0x90) return nullptr; // Overlong
+        if (lead == 0xF4 && byte(1) > 0x8F) return nullptr; // Beyond U+10FFFF
+        return it + n;
+    }
+
+    void JsonReader::skipWhitespace() { it = cu::skipWhitespace(it, last); }
+    bool JsonReader::matchAndDiscard(char ch) { skipWhitespace(); if (it == last || *it != ch) return false; ++it; return true; }
+    void JsonReader::discardExpected(char ch, const char * what) { if (!matchAndDiscard(ch)) throw JsonParseError(std::string("Syntax error: Expected ") + what); }
+
+    JsonString JsonReader::parseString()
+    {
+        auto first = it;
+        bool escaped = false;
+        while (true)
+        {
+            it = findSpecial(it, last);
+            if (it == last) throw JsonParseError("String missing closing quote");
+            auto ch = static_cast<uint8_t>(*it);
+            if (ch == '"') break;
+            else if (ch == '\\') { if (last - it < 2) throw JsonParseError("String missing closing quote"); escaped = true; it += 2; }
+            else if (ch >= 0x80) { it = skipUtf8(it, last); if (!it) throw JsonParseError("invalid UTF-8 in string literal"); }
+            else throw JsonParseError("control character found in string literal");
+        }
+        auto end = it++;
+        if (!escaped) return JsonString::borrow(first, end); // No escape characters, use the string directly
+        decode_string(first, end, buffer);
+        return JsonString::borrow(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    JsonString JsonReader::parseNumber()
+    {
+        auto first = it;
+        it = std::find_if_not(it, last, [](char ch) { return isalnum(ch) || ch == '+' || ch == '-' || ch == '.'; });
+        if (!isJsonNumber(first, it)) throw JsonParseError("Invalid number: " + std::string(first, it));
+        return JsonString::borrow(first, it);
+    }
+
+    JsonReader::Kind JsonReader::peek()
+    {
+        skipWhitespace();
+        if (it == last) throw JsonParseError("Expected value");
+        switch (*it)
+        {
+        case '"': return String;
+        case '[': return Array;
+        case '{': return Object;
+        case '-': case '0': case '1': case '2':
+        case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            return Number;
+        default:
+            if (isalpha(*it))
+            {
+                auto end = std::find_if_not(it, last, isalpha);
+                if (end - it == 4 && std::equal(it, end, "true")) return True;
+                else if (end - it == 5 && std::equal(it, end, "false")) return False;
+                else if (end - it == 4 && std::equal(it, end, "null")) return Null;
+                else throw JsonParseError("Invalid token: " + std::string(it, end));
+            }
+            else if (strchr("]},:", *it)) throw JsonParseError("Expected value");
+            else throw JsonParseError("Invalid character: \'" + std::string(1, *it) + '"');
+        }
+    }
+
+    // Parser which reports values to a handler directly from the source text, in a single pass. Rather than recursing, it keeps one bit per open array or
+    // object, so that the depth of nesting is limited only by maxDepth, and shallow documents need no allocation.
+    template<class Handler> struct JsonParser : JsonReader
+    {
+        Handler & handler;
+        size_t maxDepth, depth;         // Deepest nesting allowed, and number of arrays and objects open
+        uint64_t objects;               // Bit i is set if the container opened at depth i is an Object, for the outermost 64 levels
+        std::vector<bool> deeper;       // Likewise for the levels beyond those
+
+        JsonParser(const char * first, const char * last, Handler & handler, size_t maxDepth) : JsonReader(first, last), handler(handler), maxDepth(maxDepth), depth(), objects() {}
+
+        void open(bool object)
+        {
+            if (depth == maxDepth) throw JsonParseError("Exceeded maximum depth of nesting");
+            if (depth < 64) objects = object ? objects | 1ULL << depth : objects & ~(1ULL << depth);
+            else deeper.push_back(object);
+            ++depth;
+        }
+        void close() { if (--depth >= 64) deeper.pop_back(); }
+        bool inObject() const { return depth > 64 ? deeper.back() : (objects >> (depth - 1) & 1) != 0; }
+
+        void parseKey()
+        {
+            discardExpected('"', "string");
+            auto name = parseString();
+            handler.onKey(name.begin(), name.end());
+            discardExpected(':', ":");
+        }
+
+        void parseValue()
+        {
+            while (true)
+            {
+                // Report a scalar, or the start of an array or object, whose first element or member is then parsed in turn
+                switch (peek())
+                {
+                case Null: it += 4; handler.onNull(); break;
+                case False: it += 5; handler.onBool(false); break;
+                case True: it += 4; handler.onBool(true); break;
+                case String:
+                    {
+                        ++it;
+                        auto s = parseString();
+                        handler.onString(s.begin(), s.end());
+                    }
+                    break;
+                case Number:
+                    {
+                        auto n = parseNumber();
+                        handler.onNumber(n.begin(), n.end());
+                    }
+                    break;
+                case Array:
+                    ++it;
+                    handler.onStartArray();
+                    open(false);
+                    if (!matchAndDiscard(']')) continue;
+                    close();
+                    handler.onEndArray();
+                    break;
+                case Object:
+                    ++it;
+                    handler.onStartObject();
+                    open(true);
+                    if (!matchAndDiscard('}')) { parseKey(); continue; }
+                    close();
+                    handler.onEndObject();
+                    break;
+                }
+
+                // Report the end of any arrays and objects which are complete, then move on to the next element or member of the innermost one left
+                while (true)
+                {
+                    if (depth == 0) return;
+                    if (inObject())
+                    {
+                        if (!matchAndDiscard('}')) { discardExpected(',', ", or }"); parseKey(); break; }
+                        handler.onEndObject();
+                    }
+                    else
+                    {
+                        if (!matchAndDiscard(']')) { discardExpected(',', ", or ]"); break; }
+                        handler.onEndArray();
+                    }
+                    close();
+                }
+            }
+        }
+
+        void parseDocument()
+        {
+            parseValue();
+            skipWhitespace();
+            if (it != last) throw JsonParseError("Syntax error: Expected end-of-stream");
+        }
+
+        // Parse the comma separated elements or members of a container whose brackets lie outside the text, which must hold at least one
+        void parseSequence(bool object)
+        {
+            do { if (object) parseKey(); parseValue(); } while (matchAndDiscard(','));
+            skipWhitespace();
+            if (it != last) throw JsonParseError(object ? "Syntax error: Expected , or }" : "Syntax error: Expected , or ]");
+        }
+    };
+
+    // Handler which ignores all events, without the cost of virtual calls
+    struct JsonSkipper
+    {
+        void onNull() {}
+        void onBool(bool) {}
+        void onNumber(const char *, const char *) {}
+        void onString(const char *, const char *) {}
+        void onStartArray() {}
+        void onEndArray() {}
+        void onStartObject() {}
+        void onKey(const char *, const char *) {}
+        void onEndObject() {}
+    };
+
+    void JsonReader::skip()
+    {
+        JsonSkipper skipper;
+        JsonParser<JsonSkipper> p(it, last, skipper, JsonParseOptions().maxDepth);
+        p.parseValue();
+        it = p.it;
+    }
+
+    // Handler which assembles parse events into a tree of JsonValues, using a stack of values belonging to containers which are still open
+    struct JsonBuilder
+    {
+        enum { charsBlockSize = 4096, numbersBlockSize = 4096, maxInternedKeys = 1 << 16, maxSharedSubtrees = 1 << 16 };
+        const char * textFirst, * textLast; // Source text, or null if characters may not be borrowed from it
+        size_t textSize;                    // Length of the source text, which bounds the total length of all strings
+        JsonArena * arena;                  // Arena to allocate contents from, or null to allocate shared blocks instead
+        bool cacheNumbers;                  // Whether to store the binary value of each number
+        bool packNumbers;                   // Whether to pack the elements of Arrays made up only of numbers
+        bool shareSubtrees;                 // Whether identical Arrays and Objects share one copy of their contents
+        JsonStringBlock * chars;            // Block which short strings are currently being copied into, if not using an arena
+        size_t charsUsed;                   // Number of characters of the current block which are already in use
+        JsonNumbersBlock * integers, * reals, * floats; // Blocks which the elements of short packed Arrays are currently being stored in
+        std::vector<int64_t> scratch;       // Elements of the Array being packed, while it is still unknown whether they are all integers
+        std::vector<JsonString> pool;       // Open addressing hash table of distinct keys, with empty slots holding empty strings
+        size_t pooled;                      // Number of keys in pool, which stops growing at maxInternedKeys
+        std::vector<size_t> hashes;         // Open addressing hash table of distinct Arrays and Objects, holding their hashes, which are never 0, or 0 for empty slots,
+        std::vector<JsonValue> subtrees;    // alongside the values themselves, so that probing touches as little memory as possible
+        size_t shared;                      // Number of values in subtrees, which stops growing at maxSharedSubtrees
+        std::vector<JsonValue> values;      // Values whose enclosing container has not yet been closed
+        std::vector<JsonString> keys;       // Keys of values belonging to objects which have not yet been closed
+        std::vector<size_t> marks;          // Index of the first value of each open container
+
+        JsonBuilder(const char * first, const char * last, const JsonParseOptions & options) : textFirst(options.borrow ? first : nullptr), textLast(options.borrow ? last : nullptr), textSize(last - first), arena(options.arena), cacheNumbers(options.cacheNumbers), packNumbers(options.packNumbers && !options.arena), shareSubtrees(options.shareSubtrees && !options.arena), chars(), charsUsed(), integers(), reals(), floats(), pooled(), shared() {}
+        ~JsonBuilder() { release(chars); release(integers); release(reals); release(floats); }
+
+        template<class T> static void release(T * block) { if (block && --block->refs == 0) delete block; }
+
+        template<class T> T * allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), std::alignment_of<T>::value)); }
+
+        JsonString text(const char * first, const char * last)
+        {
+            size_t n = last - first;
+            if (n == 0) return JsonString();
+            if (textFirst && first >= textFirst && last <= textLast) return JsonString::borrow(first, last);
+            if (arena)
+            {
+                auto s = allocate<char>(n);
+                memcpy(s, first, n);
+                return JsonString::borrow(s, s + n);
+            }
+            if (n > charsBlockSize / 4) return JsonString(std::string(first, last));
+
+            // Pack short strings together into shared blocks, rather than allocating each one separately
+            if (!chars || charsUsed + n > chars->str.size())
+            {
+                release(chars);
+                chars = new JsonStringBlock(std::string(std::min(static_cast<size_t>(charsBlockSize), textSize), '\0')); // Small documents need no more than their own length
+                charsUsed = 0;
+            }
+            auto s = &chars->str[charsUsed];
+            memcpy(s, first, n);
+            charsUsed += n;
+            return JsonString(s, n, chars);
+        }
+
+        // Keys repeat far more often than strings do, as in Arrays of Objects of the same shape, so rather than copying each one, every member with a given
+        // name shares one copy of it. Keys borrowed from the source text cost nothing to begin with.
+        JsonString key(const char * first, const char * last)
+        {
+            size_t n = last - first;
+            if (n == 0 || (textFirst && first >= textFirst && last <= textLast)) return text(first, last);
+            if (pool.empty()) pool.resize(64);
+            auto mask = pool.size() - 1, slot = hash(first, n) & mask;
+            for (; !pool[slot].empty(); slot = (slot + 1) & mask) if (pool[slot].size() == n && memcmp(pool[slot].data(), first, n) == 0) return pool[slot];
+            auto str = text(first, last);
+            if (pooled == maxInternedKeys) return str;
+            pool[slot] = str;
+            if (++pooled * 2 > pool.size())
+            {
+                std::vector<JsonString> grown(pool.size() * 2);
+                for (auto & k : pool) if (!k.empty()) for (slot = hash(k.data(), k.size()) & (grown.size() - 1); ; slot = (slot + 1) & (grown.size() - 1)) if (grown[slot].empty()) { grown[slot] = std::move(k); break; }
+                pool.swap(grown);
+            }
+            return str;
+        }
+
+        // Find an Array or Object identical to val which was built before, or else remember val, and return whichever one is kept. The elements and members
+        // of both have already been shared in turn, so comparing them costs little more than comparing their addresses.
+        JsonValue share(JsonValue val)
+        {
+            if (!shareSubtrees) return val;
+            auto h = val.hash();
+            if (hashes.empty()) { hashes.resize(64); subtrees.resize(64); }
+            auto mask = hashes.size() - 1, slot = h & mask;
+            for (; hashes[slot]; slot = (slot + 1) & mask)
+            {
+                // Packed Arrays are only shared with others packed alike, so that sharing never changes how an Array holds its numbers
+                if (hashes[slot] == h && subtrees[slot].cached == val.cached && subtrees[slot] == val) return subtrees[slot];
+            }
+            if (shared == maxSharedSubtrees) return val;
+            hashes[slot] = h;
+            subtrees[slot] = val;
+            if (++shared * 2 > hashes.size())
+            {
+                std::vector<size_t> grownHashes(hashes.size() * 2);
+                std::vector<JsonValue> grown(hashes.size() * 2);
+                for (size_t i = 0; i < hashes.size(); ++i) if (hashes[i]) for (slot = hashes[i] & (grown.size() - 1); ; slot = (slot + 1) & (grown.size() - 1)) if (!grownHashes[slot]) { grownHashes[slot] = hashes[i]; grown[slot] = std::move(subtrees[i]); break; }
+                hashes.swap(grownHashes);
+                subtrees.swap(grown);
+            }
+            return val;
+        }
+
+        // Store the binary values of numbers in a block with room for them, which short Arrays share with one another
+        template<class T> T * store(JsonNumbersBlock *& current, std::vector<T> JsonNumbersBlock::* slots, size_t n, JsonNumbersBlock *& block)
+        {
+            if (n > numbersBlockSize / 4) block = new JsonNumbersBlock(slots, n);
+            else
+            {
+                if (!current || (current->*slots).size() + n > (current->*slots).capacity())
+                {
+                    release(current);
+                    current = new JsonNumbersBlock(slots, std::min(static_cast<size_t>(numbersBlockSize), textSize / 2 + 1)); // Each number takes at least two characters, or bytes
+                }
+                block = current;
+                ++block->refs;
+            }
+            auto & v = block->*slots;
+            v.resize(v.size() + n);
+            return v.data() + v.size() - n;
+        }
+
+        // Pack the binary values of an Array made up only of numbers into a shared block, as floats if they all are, as integers if they all are, or else as
+        // doubles, provided that neither loses any integer's value, nor prints any float differently. Returns null if the Array is empty or cannot be packed.
+        JsonValue pack(std::vector<JsonValue>::iterator first)
+        {
+            size_t n = end(values) - first;
+            if (!n || !std::all_of(first, end(values), [](const JsonValue & v) { return v.isNumber(); })) return JsonValue();
+            bool integral = true, large = false;
+            size_t singles = 0;
+            scratch.clear();
+            for (auto it = first; it != end(values); ++it)
+            {
+                int64_t i;
+                if (!it->digits && it->cached == JsonValue::Single) { integral = false; ++singles; continue; }
+                if (it->digits)
+                {
+                    JsonDecimal d(it->chars(), it->chars() + it->digits);
+                    if (!d.integral) { integral = false; continue; }
+                    if (d.truncated || d.mantissa > (d.negative ? 1ULL << 63 : static_cast<uint64_t>(INT64_MAX))) return JsonValue();
+                    i = d.negative ? static_cast<int64_t>(0 - d.mantissa) : static_cast<int64_t>(d.mantissa);
+                }
+                else if (it->cached == JsonValue::Real) { integral = false; continue; }
+                else if (!it->numberAs(i)) return JsonValue(); // Numbers decoded from CBOR have no text
+                large |= i < -(1LL << 53) || i > 1LL << 53;
+                scratch.push_back(i);
+            }
+            if ((singles && singles < n) || (!integral && large)) return JsonValue();
+            JsonNumbersBlock * block;
+            const void * data;
+            auto cache = singles ? JsonValue::Single : integral ? JsonValue::Integer : JsonValue::Real;
+            if (singles)
+            {
+                auto out = store(floats, &JsonNumbersBlock::floats, n, block);
+                data = out;
+                for (auto it = first; it != end(values); ++it) *out++ = static_cast<float>(it->real);
+            }
+            else if (integral) data = std::copy(scratch.begin(), scratch.end(), store(integers, &JsonNumbersBlock::integers, n, block)) - n;
+            else
+            {
+                auto out = store(reals, &JsonNumbersBlock::reals, n, block);
+                data = out;
+                for (auto it = first; it != end(values); ++it) it->numberAs(*out++);
+            }
+            JsonValue arr(JsonValue::Array, block, data, n);
+            arr.cached = cache;
+            return arr;
+        }
+
+        void onNull() { values.emplace_back(nullptr); }
+        void onBool(bool b) { values.emplace_back(b); }
+        void onNumber(const char * first, const char * last)
+        {
+            values.push_back(JsonValue::fromNumber(text(first, last)));
+            if (cacheNumbers) values.back().cacheNumber();
+        }
+        void onString(const char * first, const char * last) { values.emplace_back(text(first, last)); }
+        void onStartArray() { marks.push_back(values.size()); }
+        void onStartObject() { marks.push_back(values.size()); }
+        void onKey(const char * first, const char * last) { keys.push_back(key(first, last)); }
+        void onEndArray()
+        {
+            auto first = begin(values) + marks.back(); marks.pop_back();
+            if (arena)
+            {
+                // Arena contents never hold references to shared blocks, so moved-from values need not be destroyed
+                size_t n = end(values) - first;
+                auto elements = std::uninitialized_copy(std::make_move_iterator(first), std::make_move_iterator(end(values)), allocate<JsonValue>(n)) - n;
+                values.erase(first, end(values));
+                values.push_back(JsonValue(JsonValue::Array, nullptr, elements, n));
+            }
+            else
+            {
+                auto arr = packNumbers ? pack(first) : JsonValue();
+                auto text = arr.isArray() ? first->chars() : nullptr;
+                if (!arr.isArray()) arr = JsonArray(std::make_move_iterator(first), std::make_move_iterator(end(values)));
+                values.erase(first, end(values));
+                values.push_back(share(std::move(arr)));
+
+                // The text of packed numbers is no longer needed, and if it was copied, nothing else has been copied since
+                if (text && chars && text >= chars->str.data() && text < chars->str.data() + charsUsed) charsUsed = text - chars->str.data();
+            }
+        }
+        void onEndObject()
+        {
+            auto first = begin(values) + marks.back(); marks.pop_back();
+            size_t n = end(values) - first;
+            auto key = end(keys) - n;
+            if (arena)
+            {
+                auto members = allocate<JsonMember>(n);
+                for (size_t i = 0; i < n; ++i) new (members + i) JsonMember(std::move(key[i]), std::move(first[i]));
+                keys.erase(key, end(keys));
+                values.erase(first, end(values));
+                values.push_back(JsonValue(JsonValue::Object, nullptr, members, n));
+            }
+            else
+            {
+                JsonObject obj;
+                obj.reserve(n);
+                for (size_t i = 0; i < n; ++i) obj.emplace_back(std::move(key[i]), std::move(first[i]));
+                keys.erase(key, end(keys));
+                values.erase(first, end(values));
+                values.push_back(share(std::move(obj)));
+            }
+        }
+    };
+
+    JsonValue jsonFrom(const char * first, const char * last, const JsonParseOptions & options)
+    {
+        JsonBuilder builder(first, last, options);
+        JsonParser<JsonBuilder> p(first, last, builder, options.maxDepth);
+        p.parseDocument();
+        return std::move(builder.values.back());
+    }
+
+    JsonValue jsonFrom(const std::string & text, const JsonParseOptions & options) { return jsonFrom(text.data(), text.data() + text.size(), options); }
+
+    void jsonParse(const std::string & text, JsonHandler & handler, const JsonParseOptions & options)
+    {
+        JsonParser<JsonHandler> p(text.data(), text.data() + text.size(), handler, options.maxDepth);
+        p.parseDocument();
+    }
+
+    // End of the string literal whose opening quote precedes it, without checking its contents
+    static const char * skipQuoted(const char * it, const char * last)
+    {
+        while (true)
+        {
+            it = findQuoting(it, last);
+            if (it == last) throw JsonParseError("String missing closing quote");
+            if (*it == '"') return it + 1;
+            if (*it == '\\' && last - it < 2) throw JsonParseError("String missing closing quote");
+            it += *it == '\\' ? 2 : 1;
+        }
+    }
+
+    // End of the value starting at it, found by matching quotes and brackets without checking anything else
+    static const char * skipStructure(const char * it, const char * last)
+    {
+        if (*it == '"') return skipQuoted(it + 1, last);
+        if (*it != '[' && *it != '{') return std::find_if_not(it, last, [](char ch) { return isalnum(ch) || ch == '+' || ch == '-' || ch == '.'; });
+        size_t depth = 0;
+        while (true)
+        {
+        #ifdef COPPER_JSON_SIMD
+            // Brackets are dense in arrays of numbers, so handle every one within a block before loading the next, until a string interrupts
+            if (last - it >= COPPER_JSON_SIMD)
+            {
+                auto mask = JsonChars(it).structural();
+                for (; mask; mask &= mask - 1)
+                {
+                    auto ch = it[lowestBit(mask)];
+                    if (ch == '"') break;
+                    if (ch == '[' || ch == '{') ++depth;
+                    else if (--depth == 0) return it + lowestBit(mask) + 1;
+                }
+                if (!mask) { it += COPPER_JSON_SIMD; continue; }
+                it = skipQuoted(it + lowestBit(mask) + 1, last);
+                continue;
+            }
+        #endif
+            it = findStructural(it, last);
+            if (it == last) throw JsonParseError("Array or object missing closing bracket");
+            switch (*it++)
+            {
+            case '"': it = skipQuoted(it, last); break;
+            case '[': case '{': ++depth; break;
+            default: if (--depth == 0) return it;
+            }
+        }
+    }
+
+    JsonValue JsonReader::readValue(const JsonParseOptions & options)
+    {
+        // Find the end of the value first, so that the builder sizes its blocks to fit the value rather than the rest of the text
+        peek();
+        auto end = skipStructure(it, last);
+        JsonBuilder builder(it, end, options);
+        JsonParser<JsonBuilder> p(it, end, builder, options.maxDepth);
+        p.parseDocument();
+        it = p.it;
+        return std::move(builder.values.back());
+    }
+
+    // Reader which finds the elements or members of a JsonLazyValue, skipping over their text rather than parsing it
+    struct JsonLazyIndexer : JsonReader
+    {
+        const JsonDocument * doc;
+
+        JsonLazyIndexer(const JsonDocument * doc, const char * first, const char * last) : JsonReader(first, last), doc(doc) {}
+
+        JsonLazyValue readLazily()
+        {
+            peek();
+            auto first = it;
+            it = skipStructure(it, last);
+            return JsonLazyValue(doc, first, it);
+        }
+    };
+
+    JsonLazyValue::~JsonLazyValue() { delete index.load(); delete parsed.load(); }
+
+    const JsonLazyIndex & JsonLazyValue::indexed() const
+    {
+        auto found = index.load(std::memory_order_acquire);
+        if (found) return *found;
+        std::unique_ptr<JsonLazyIndex> built(new JsonLazyIndex);
+        JsonLazyIndexer r(doc, first, last);
+        if (isArray() && r.readStartArray()) do built->elements.push_back(r.readLazily()); while (r.readNextElement());
+        if (isObject() && r.readStartObject()) do
+        {
+            auto key = r.readKey();
+            if (key.begin() < first || key.end() > last) key = JsonString(key.str()); // Keys with escape sequences are decoded into a buffer which is reused
+            built->members.emplace_back(std::move(key), r.readLazily());
+        } while (r.readNextMember());
+        r.readEnd();
+        if (built->members.size() >= minIndexedMembers)
+        {
+            built->slots.resize(indexCapacity(built->members.size()));
+            for (size_t i = 0; i < built->members.size(); ++i) indexMember(built->slots.data(), built->members, i);
+        }
+        return *publishOnce(index, std::move(built));
+    }
+
+    const JsonLazyValue & JsonLazyValue::operator[](size_t index) const
+    {
+        static const JsonLazyValue null(nullptr, "null", "null" + 4);
+        auto arr = array();
+        return index < arr.size() ? arr[index] : null;
+    }
+
+    const JsonLazyValue & JsonLazyValue::member(const char * key, size_t length) const
+    {
+        static const JsonLazyValue null(nullptr, "null", "null" + 4);
+        auto obj = object();
+        if (!indexed().slots.empty()) { auto m = findIndexed(indexed().slots.data(), obj, key, length); return m ? m->second : null; }
+        for (auto & m : obj) if (m.first.size() == length && memcmp(m.first.data(), key, length) == 0) return m.second;
+        return null;
+    }
+
+    array_ref<JsonLazyValue> JsonLazyValue::array() const
+    {
+        if (!isArray()) return{ nullptr, nullptr };
+        auto & elements = indexed().elements;
+        return{ elements.data(), elements.data() + elements.size() };
+    }
+
+    array_ref<JsonLazyMember> JsonLazyValue::object() const
+    {
+        if (!isObject()) return{ nullptr, nullptr };
+        auto & members = indexed().members;
+        return{ members.data(), members.data() + members.size() };
+    }
+
+    const JsonValue & JsonLazyValue::value() const
+    {
+        auto found = parsed.load(std::memory_order_acquire);
+        if (found) return *found;
+        return *publishOnce(parsed, std::unique_ptr<JsonValue>(new JsonValue(jsonFrom(first, last, doc ? doc->options : JsonParseOptions()))));
+    }
+
+    static const char * trimmed(const char * first, const char * & last)
+    {
+        first = skipWhitespace(first, last);
+        if (first == last) throw JsonParseError("Expected value");
+        while (isspace(static_cast<uint8_t>(last[-1]))) --last;
+        return first;
+    }
+
+    JsonDocument::JsonDocument(std::string text, const JsonParseOptions & options) : owned(move(text)), options(options), root(this, owned.data(), owned.data() + owned.size())
+    {
+        root.first = trimmed(root.first, root.last);
+    }
+
+    JsonDocument::JsonDocument(const char * first, const char * last, const JsonParseOptions & options) : options(options), root(this, first, last)
+    {
+        root.first = trimmed(root.first, root.last);
+    }
+
+    JsonQuery::JsonQuery(const std::vector<std::string> & paths) : count(paths.size())
+    {
+        // Build a trie of the paths, in which wildcards are edges of their own, and node 0 is the root, so that no edge leads to it
+        struct Node { std::vector<std::pair<std::string, size_t>> children; size_t wildcard; std::vector<size_t> paths; };
+        std::vector<Node> trie(1, Node{ {}, 0, {} });
+        for (size_t p = 0; p < paths.size(); ++p)
+        {
+            auto & path = paths[p];
+            if (!path.empty() && path[0] != '/') throw std::invalid_argument("JSON path must be empty or start with '/': " + path);
+            size_t node = 0;
+            for (size_t i = 0; i < path.size(); )
+            {
+                auto end = std::min(path.find('/', i + 1), path.size());
+                std::string segment;
+                for (++i; i < end; ++i) segment += path[i] == '~' && i + 1 < end && (path[i + 1] == '0' || path[i + 1] == '1') ? path[++i] == '0' ? '~' : '/' : path[i];
+                size_t child = 0;
+                if (segment == "*") child = trie[node].wildcard;
+                else for (auto & c : trie[node].children) if (c.first == segment) child = c.second;
+                if (!child)
+                {
+                    child = trie.size();
+                    if (segment == "*") trie[node].wildcard = child;
+                    else trie[node].children.emplace_back(segment, child);
+                    trie.push_back(Node{ {}, 0, {} });
+                }
+                node = child;
+            }
+            trie[node].paths.push_back(p);
+        }
+
+        // Determinize it, so that each state stands for the set of trie nodes which some sequence of keys leads to, and wildcards never need backtracking
+        std::map<std::vector<size_t>, size_t> ids;
+        std::vector<std::vector<size_t>> sets(1);
+        auto stateOf = [&](std::vector<size_t> nodes) -> size_t
+        {
+            if (nodes.empty()) return 0;
+            std::sort(nodes.begin(), nodes.end());
+            nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+            auto & id = ids[nodes];
+            if (!id) { id = sets.size(); sets.push_back(nodes); }
+            return id;
+        };
+        stateOf({ 0 });
+        for (size_t s = 1; s < sets.size(); ++s)
+        {
+            auto nodes = sets[s];
+            State state = { {}, {}, 0, {} };
+            std::vector<size_t> wildcards;
+            std::vector<std::string> keys;
+            for (auto n : nodes)
+            {
+                if (trie[n].wildcard) wildcards.push_back(trie[n].wildcard);
+                for (auto & c : trie[n].children) keys.push_back(c.first);
+                state.matches.insert(state.matches.end(), trie[n].paths.begin(), trie[n].paths.end());
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            std::sort(state.matches.begin(), state.matches.end());
+            state.other = stateOf(wildcards);
+            for (auto & key : keys)
+            {
+                auto targets = wildcards;
+                for (auto n : nodes) for (auto & c : trie[n].children) if (c.first == key) targets.push_back(c.second);
+                auto target = stateOf(targets);
+                state.members.emplace_back(key, target);
+                bool index = !key.empty() && key.size() < 19 && std::all_of(key.begin(), key.end(), [](char ch) { return ch >= '0' && ch <= '9'; }) && (key[0] != '0' || key.size() == 1); // Array indices are written without leading zeros
+                if (index) state.elements.emplace_back(std::stoull(key), target);
+            }
+            states.resize(sets.size());
+            states[s] = std::move(state);
+        }
+        states.resize(sets.size());
+        states[0] = State{ {}, {}, 0, {} };
+    }
+
+    size_t JsonQuery::next(size_t state, const char * key, size_t length) const
+    {
+        for (auto & m : states[state].members) if (m.first.size() == length && memcmp(m.first.data(), key, length) == 0) return m.second;
+        return states[state].other;
+    }
+
+    size_t JsonQuery::next(size_t state, size_t index) const
+    {
+        for (auto & e : states[state].elements) if (e.first == index) return e.second;
+        return states[state].other;
+    }
+
+    void JsonQuery::match(size_t state, const JsonValue & val, const std::function<void(size_t path, const JsonValue & val)> & onMatch) const
+    {
+        auto & s = states[state];
+        for (auto path : s.matches) onMatch(path, val);
+        if (s.members.empty() && !s.other) return;
+        size_t i = 0;
+        for (auto & elem : val.array()) if (auto n = next(state, i++)) match(n, elem, onMatch);
+        for (auto & m : val.object()) if (auto n = next(state, m.first.data(), m.first.size())) match(n, m.second, onMatch);
+    }
+
+    // Reader which follows a JsonQuery through a document, recursing only as deep as the longest path
+    struct JsonQueryRunner : JsonReader
+    {
+        const JsonQuery & query;
+        const std::function<void(size_t path, const JsonValue & val)> & onMatch;
+        const JsonParseOptions & options;
+
+        JsonQueryRunner(const char * first, const char * last, const JsonQuery & query, const std::function<void(size_t, const JsonValue &)> & onMatch, const JsonParseOptions & options) : JsonReader(first, last), query(query), onMatch(onMatch), options(options) {}
+
+        void visit(size_t state)
+        {
+            if (!query.states[state].matches.empty()) return query.match(state, readValue(options), onMatch); // Paths which continue further are followed through the parsed value
+            auto kind = peek();
+            if (state && kind == Array && (query.states[state].other || !query.states[state].elements.empty())) // Arrays which no path indexes into are skipped whole
+            {
+                size_t i = 0;
+                if (readStartArray()) do visit(query.next(state, i++)); while (readNextElement());
+            }
+            else if (state && kind == Object)
+            {
+                if (readStartObject()) do { auto key = readKey(); visit(query.next(state, key.data(), key.size())); } while (readNextMember());
+            }
+            else it = skipStructure(it, last);
+        }
+    };
+
+    void JsonQuery::evaluate(const char * first, const char * last, const std::function<void(size_t path, const JsonValue & val)> & onMatch, const JsonParseOptions & options) const
+    {
+        JsonQueryRunner r(first, last, *this, onMatch, options);
+        r.visit(1);
+        r.readEnd();
+    }
+
+    std::vector<JsonArray> JsonQuery::evaluate(const std::string & text, const JsonParseOptions & options) const
+    {
+        std::vector<JsonArray> results(count);
+        evaluate(text.data(), text.data() + text.size(), [&results](size_t path, const JsonValue & val) { results[path].push_back(val); }, options);
+        return results;
+    }
+
+    JsonStream::JsonStream(const JsonParseOptions & options) : options(options), start(), scanned(), depth(), state(Between), finished() { this->options.borrow = false; }
+
+    void JsonStream::feed(const char * first, const char * last)
+    {
+        // Discard consumed input once it makes up most of the buffer, so that the buffer only grows to fit the largest value
+        if (start > 0 && start >= buffer.size() / 2)
+        {
+            buffer.erase(0, start);
+            scanned -= start;
+            start = 0;
+        }
+        buffer.append(first, last);
+    }
+
+    void JsonStream::finish() { finished = true; }
+
+    bool JsonStream::scan(size_t & end)
+    {
+        auto s = buffer.data(), it = s + scanned, last = s + buffer.size();
+        auto complete = [&](const char * e) { end = e - s; state = Between; return true; };
+        while (true)
+        {
+            switch (state)
+            {
+            case Between:
+                it = cu::skipWhitespace(it, last);
+                start = it - s;
+                if (it == last) break;
+                state = *it == '{' || *it == '[' ? Nested : *it == '"' ? Quoted : Bare;
+                depth = state == Nested;
+                ++it;
+                continue;
+            case Nested:
+                for (; it != last; ++it)
+                {
+                    if (*it == '"') break;
+                    if (*it == '{' || *it == '[') ++depth;
+                    else if ((*it == '}' || *it == ']') && --depth == 0) return complete(it + 1);
+                }
+                if (it == last) break;
+                state = Quoted;
+                ++it;
+                continue;
+            case Quoted:
+                it = findSpecial(it, last);
+                if (it == last) break;
+                if (*it == '\\')
+                {
+                    if (last - it < 2) break; // Wait for the escaped character, so that an escaped quote is not mistaken for the end of the string
+                    it += 2;
+                    continue;
+                }
+                if (*it++ != '"') continue; // Control and non-ASCII characters are left for the parser to check
+                if (depth == 0) return complete(it);
+                state = Nested;
+                continue;
+            case Bare:
+                while (it != last && !isspace(static_cast<uint8_t>(*it)) && !strchr("[]{},:\"", *it)) ++it;
+                if (it != last) return complete(it);
+                if (finished) return complete(last);
+                break;
+            }
+            break;
+        }
+        scanned = it - s;
+        if (finished && state != Between)
+        {
+            start = scanned = buffer.size();
+            state = Between;
+            throw JsonParseError("Unexpected end of stream");
+        }
+        return false;
+    }
+
+    bool JsonStream::next(JsonValue & value)
+    {
+        size_t end;
+        if (!scan(end)) return false;
+        auto first = buffer.data() + start;
+        start = scanned = end; // Consume the value before parsing it, so that a malformed value is skipped
+        value = jsonFrom(first, buffer.data() + end, options);
+        return true;
+    }
+
+    JsonValue jsonFrom(std::istream & in, const JsonParseOptions & options)
+    {
+        JsonValue value;
+        bool found = false;
+        jsonFromStream(in, [&](JsonValue v) { if (found) throw JsonParseError("Syntax error: Expected end-of-stream"); value = std::move(v); found = true; }, options);
+        if (!found) throw JsonParseError("Expected value");
+        return value;
+    }
+
+    void jsonFromStream(std::istream & in, const std::function<void(JsonValue)> & onValue, const JsonParseOptions & options)
+    {
+        JsonStream stream(options);
+        JsonValue value;
+        char chunk[1 << 16];
+        while (in)
+        {
+            in.read(chunk, sizeof(chunk));
+            stream.feed(chunk, chunk + in.gcount());
+            while (stream.next(value)) onValue(std::move(value));
+        }
+        stream.finish();
+        while (stream.next(value)) onValue(std::move(value));
+    }
+
+    // Read-only view of the entire contents of a file, which remains mapped into memory until destroyed
+    class MappedFile
+    {
+        const char * first, * last;
+    #ifdef _WIN32
+        HANDLE file, mapping;
+    #else
+        int file;
+    #endif
+    public:
+        MappedFile(const std::string & path);
+        MappedFile(const MappedFile &) = delete;
+        ~MappedFile();
+
+        const char * begin() const { return first; }
+        const char * end() const { return last; }
+    };
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string & path) : first(), last(), mapping()
+    {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("File not found: " + path);
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) { CloseHandle(file); throw std::runtime_error("Could not read file: " + path); }
+        if (size.QuadPart == 0) return; // Empty files cannot be mapped
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) first = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!first) { if (mapping) CloseHandle(mapping); CloseHandle(file); throw std::runtime_error("Could not map file: " + path); }
+        last = first + size.QuadPart;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (first) UnmapViewOfFile(first);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+    }
+#else
+    MappedFile::MappedFile(const std::string & path) : first(), last()
+    {
+        file = open(path.c_str(), O_RDONLY);
+        if (file < 0) throw std::runtime_error("File not found: " + path);
+        struct stat info;
+        if (fstat(file, &info) != 0) { close(file); throw std::runtime_error("Could not read file: " + path); }
+        if (info.st_size == 0) return; // Empty files cannot be mapped
+        auto view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED) { close(file); throw std::runtime_error("Could not map file: " + path); }
+        madvise(view, info.st_size, MADV_SEQUENTIAL);
+        first = static_cast<const char *>(view);
+        last = first + info.st_size;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (first) munmap(const_cast<char *>(first), last - first);
+        close(file);
+    }
+#endif
+
+    JsonValue jsonFromFile(const std::string & path, const JsonParseOptions & options, unsigned threads)
+    {
+        MappedFile file(path);
+        auto copying = options;
+        copying.borrow = false; // The mapping does not outlive this call
+        return threads == 1 ? jsonFrom(file.begin(), file.end(), copying) : jsonFromParallel(file.begin(), file.end(), copying, threads);
+    }
+
+    // Parse each nonblank line of [first, last), which begins on the given line number
+    template<class F> static void parseLines(const char * first, const char * last, size_t line, const JsonParseOptions & options, F onValue)
+    {
+        for (; first != last; ++line)
+        {
+            auto end = static_cast<const char *>(memchr(first, '\n', last - first));
+            if (!end) end = last;
+            if (skipWhitespace(first, end) != end) onValue(line, jsonFrom(first, end, options));
+            first = end == last ? last : end + 1;
+        }
+    }
+
+    // Divide [first, last) into up to the given number of ranges of whole lines, and call work(index, first, last) on each range from its own thread
+    template<class F> static void forEachLineRange(const char * first, const char * last, const JsonParseOptions & options, unsigned threads, F work)
+    {
+        enum { minRangeSize = 1 << 16 }; // Smaller ranges are not worth a thread
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1U);
+        if (options.arena) threads = 1;
+        threads = static_cast<unsigned>(std::min<size_t>(threads, (last - first) / minRangeSize + 1));
+
+        std::vector<const char *> bounds(threads + 1, last);
+        bounds[0] = first;
+        for (unsigned i = 1; i < threads; ++i)
+        {
+            auto it = std::max(first + (last - first) * i / threads, bounds[i - 1]);
+            auto newline = static_cast<const char *>(memchr(it, '\n', last - it));
+            bounds[i] = newline ? newline + 1 : last;
+        }
+
+        std::vector<std::exception_ptr> errors(threads);
+        auto run = [&](unsigned i) { try { work(i, bounds[i], bounds[i + 1]); } catch (...) { errors[i] = std::current_exception(); } };
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; ++i) workers.emplace_back(run, i);
+        run(0);
+        for (auto & worker : workers) worker.join();
+        for (auto & error : errors) if (error) std::rethrow_exception(error);
+    }
+
+    std::vector<JsonValue> jsonLinesFrom(const char * first, const char * last, const JsonParseOptions & options, unsigned threads)
+    {
+        std::vector<std::vector<JsonValue>> ranges(threads ? threads : std::max(std::thread::hardware_concurrency(), 1U));
+        forEachLineRange(first, last, options, static_cast<unsigned>(ranges.size()), [&](unsigned i, const char * f, const char * l)
+        {
+            parseLines(f, l, 0, options, [&](size_t, JsonValue value) { ranges[i].push_back(std::move(value)); });
+        });
+
+        std::vector<JsonValue> values;
+        size_t n = 0;
+        for (auto & range : ranges) n += range.size();
+        values.reserve(n);
+        for (auto & range : ranges) std::move(range.begin(), range.end(), std::back_inserter(values));
+        return values;
+    }
+
+    void jsonLinesFrom(const char * first, const char * last, const std::function<void(size_t line, JsonValue value)> & onValue, const JsonParseOptions & options, unsigned threads)
+    {
+        // Count the lines of each range in a first pass, so that each range knows the number of its first line
+        std::vector<size_t> lines(threads ? threads : std::max(std::thread::hardware_concurrency(), 1U));
+        forEachLineRange(first, last, options, static_cast<unsigned>(lines.size()), [&](unsigned i, const char * f, const char * l)
+        {
+            for (; (f = static_cast<const char *>(memchr(f, '\n', l - f))) != nullptr; ++f) ++lines[i];
+        });
+        size_t line = 0;
+        for (auto & n : lines) { auto count = n; n = line; line += count; }
+        forEachLineRange(first, last, options, static_cast<unsigned>(lines.size()), [&](unsigned i, const char * f, const char * l)
+        {
+            parseLines(f, l, lines[i], options, onValue);
+        });
+    }
+
+    // Divides a document into chunks of consecutive elements or members of its outermost Arrays and Objects, by matching quotes and brackets. Values too large
+    // for one chunk are divided in turn, down to a limited depth. Each chunk is parsed on its own, and the results are then joined in the order they appeared.
+    struct JsonSplitter : JsonReader
+    {
+        enum { maxSplitDepth = 16 };        // Containers nested deeper than this are never divided
+        struct Chunk
+        {
+            const char * first, * last;     // Text of the elements or members, without the brackets around them
+            size_t depth;                   // Number of containers enclosing them
+            bool object;
+            std::vector<JsonValue> values;  // Parsed elements, or values of members
+            std::vector<JsonString> keys;   // Parsed names of members
+        };
+        struct Part { size_t index; bool chunk; JsonString key; }; // Chunk, or divided container with the name it has in its own container, if any
+        struct Node { bool object; std::vector<Part> parts; };     // Container which is divided into several parts
+
+        const JsonParseOptions & options;
+        size_t chunkSize;                   // Length of text above which values are divided and chunks are closed
+        std::deque<Chunk> chunks;           // Chunks found so far, which stay in place while the parsing threads read them
+        std::vector<Node> nodes;            // Divided containers, starting with the outermost
+        std::mutex mutex;
+        std::condition_variable found;      // Signaled when a chunk is added, or when no more will be
+        size_t parsed;                      // Number of chunks which threads have begun to parse
+        bool done;                          // Whether all chunks have been found
+        std::atomic<bool> failed;           // Whether anything turned out to be malformed
+
+        JsonSplitter(const char * first, const char * last, const JsonParseOptions & options, size_t chunkSize) : JsonReader(first, last), options(options), chunkSize(chunkSize), parsed(), done(), failed() {}
+
+        void addChunk(size_t node, const char * first, const char * last, size_t depth)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks.push_back(Chunk{ first, last, depth, nodes[node].object, {}, {} });
+            nodes[node].parts.push_back(Part{ chunks.size() - 1, true, {} });
+            found.notify_one();
+        }
+
+        // Match quotes and brackets from it, which lies between the items of a container, to the first comma between items at or after target, which must lie
+        // within the text, or to the container's closing bracket, and return which one it stopped at. Stops instead at the opening bracket of an item which spans
+        // more than chunkSize characters, returning Large. Nothing else is checked, which is left to the parse of each chunk.
+        enum Stop { Comma, Close, Large };
+        Stop scanItems(const char * target)
+        {
+            size_t depth = 0;
+            const char * opened = nullptr; // Opening bracket of the current item, if depth is not 0
+            while (true)
+            {
+            #ifdef COPPER_JSON_SIMD
+                // As in skipStructure, handle every bracket within a block before loading the next, until a string interrupts or the item ends
+                if (depth && last - it >= COPPER_JSON_SIMD)
+                {
+                    auto mask = JsonChars(it).structural();
+                    for (; mask; mask &= mask - 1)
+                    {
+                        auto ch = it[lowestBit(mask)];
+                        if (ch == '"') break;
+                        if (ch == '[' || ch == '{') ++depth;
+                        else if (--depth == 0) break;
+                    }
+                    if (!mask) it += COPPER_JSON_SIMD;
+                    else if (it[lowestBit(mask)] == '"') it = skipQuoted(it + lowestBit(mask) + 1, last);
+                    else it += lowestBit(mask) + 1;
+                    if (depth && static_cast<size_t>(it - opened) > chunkSize) { it = opened; return Large; }
+                    continue;
+                }
+            #endif
+                if (depth == 0 && it >= target)
+                {
+                    // The rest of the current item is usually short, so look for the comma which ends it one character at a time
+                    it = std::find_if(it, last, [](char ch) { return ch == ',' || ch == '"' || ch == '[' || ch == ']' || ch == '{' || ch == '}'; });
+                    if (it == last) throw JsonParseError("Array or object missing closing bracket");
+                    if (*it == ',') return Comma;
+                }
+                else
+                {
+                    auto bound = depth == 0 ? target : static_cast<size_t>(last - opened) > chunkSize ? opened + chunkSize : last;
+                    it = findStructural(it, bound);
+                    if (it == last) throw JsonParseError("Array or object missing closing bracket");
+                    if (it == bound) { if (depth) { it = opened; return Large; } continue; }
+                }
+                switch (*it++)
+                {
+                case '"': it = skipQuoted(it, last); break;
+                case '[': case '{': if (depth++ == 0) opened = it - 1; break;
+                default: if (depth == 0) { --it; return Close; } --depth;
+                }
+                if (depth && static_cast<size_t>(it - opened) > chunkSize) { it = opened; return Large; }
+            }
+        }
+
+        // Divide the contents of the container opened just before it, whose elements or members are at the given depth, and consume its closing bracket
+        void split(size_t node, size_t depth)
+        {
+            bool object = nodes[node].object;
+            const char * close = object ? "}" : "]", * expected = object ? ", or }" : ", or ]";
+            if (matchAndDiscard(*close)) return;
+            while (true)
+            {
+                skipWhitespace();
+                auto chunkFirst = it;
+                if (it == last || *it == ',' || *it == *close) throw JsonParseError("Expected value");
+                auto stop = scanItems(static_cast<size_t>(last - chunkFirst) > chunkSize ? chunkFirst + chunkSize : last);
+                if (stop != Large)
+                {
+                    addChunk(node, chunkFirst, it++, depth);
+                    if (stop == Close) return;
+                    continue;
+                }
+
+                // Find the item whose value is the large container, and add the items before it as a chunk of their own
+                auto opened = it;
+                const char * itemFirst, * chunkLast = nullptr;
+                JsonString key;
+                it = chunkFirst;
+                while (true)
+                {
+                    skipWhitespace();
+                    itemFirst = it;
+                    if (object)
+                    {
+                        discardExpected('"', "string");
+                        key = parseString();
+                        discardExpected(':', ":");
+                    }
+                    peek();
+                    if (it == opened) break;
+                    if (it > opened) throw JsonParseError(std::string("Syntax error: Expected ") + expected);
+                    it = skipStructure(it, last);
+                    chunkLast = it;
+                    discardExpected(',', expected);
+                }
+                if (chunkLast) addChunk(node, chunkFirst, chunkLast, depth);
+
+                if (depth < options.maxDepth && depth < maxSplitDepth)
+                {
+                    if (!key.empty() && !(options.borrow && key.begin() >= chunkFirst && key.end() <= opened)) key = JsonString(key.str()); // Keys decoded into the buffer do not last
+                    nodes.push_back(Node{ *it == '{', {} });
+                    nodes[node].parts.push_back(Part{ nodes.size() - 1, false, std::move(key) });
+                    ++it;
+                    split(nodes.size() - 1, depth + 1);
+                }
+                else
+                {
+                    it = skipStructure(it, last);
+                    addChunk(node, itemFirst, it, depth);
+                }
+                if (!matchAndDiscard(',')) { discardExpected(*close, expected); return; }
+            }
+        }
+
+        // Divide the outermost container, whose opening bracket precedes the text
+        void splitDocument()
+        {
+            split(0, 1);
+            skipWhitespace();
+            if (it != last) throw JsonParseError("Syntax error: Expected end-of-stream");
+        }
+
+        // Parse chunks as they are found, until all of them have been parsed
+        void parseChunks()
+        {
+            while (true)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                found.wait(lock, [this] { return parsed < chunks.size() || done; });
+                if (parsed == chunks.size()) return;
+                auto & chunk = chunks[parsed++];
+                lock.unlock();
+                if (failed) continue;
+                try
+                {
+                    JsonBuilder builder(chunk.first, chunk.last, options);
+                    JsonParser<JsonBuilder> p(chunk.first, chunk.last, builder, options.maxDepth - chunk.depth);
+                    p.parseSequence(chunk.object);
+                    chunk.values.swap(builder.values);
+                    chunk.keys.swap(builder.keys);
+                }
+                catch (...) { failed = true; } // Parsing again on one thread will throw whatever this was
+            }
+        }
+
+        // Join the parts of a divided container into one value, which is pushed onto the builder, as if its contents had been parsed in place
+        void join(JsonBuilder & builder, size_t node)
+        {
+            builder.marks.push_back(builder.values.size());
+            auto n = builder.values.size();
+            for (auto & part : nodes[node].parts) n += part.chunk ? chunks[part.index].values.size() : 1;
+            builder.values.reserve(n);
+            if (nodes[node].object) builder.keys.reserve(builder.keys.size() + n - builder.marks.back());
+            for (auto & part : nodes[node].parts)
+            {
+                if (!part.chunk)
+                {
+                    if (nodes[node].object) builder.keys.push_back(std::move(part.key));
+                    join(builder, part.index);
+                    continue;
+                }
+                auto & chunk = chunks[part.index];
+                std::move(chunk.values.begin(), chunk.values.end(), std::back_inserter(builder.values));
+                std::move(chunk.keys.begin(), chunk.keys.end(), std::back_inserter(builder.keys));
+                std::vector<JsonValue>().swap(chunk.values);
+                std::vector<JsonString>().swap(chunk.keys);
+            }
+            if (nodes[node].object) builder.onEndObject(); else builder.onEndArray();
+        }
+    };
+
+    JsonValue jsonFromParallel(const char * first, const char * last, const JsonParseOptions & options, unsigned threads)
+    {
+        enum { minChunkSize = 1 << 16, chunksPerThread = 8 }; // Several chunks per thread even out the time each one takes
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1U);
+        auto root = skipWhitespace(first, last);
+        if (threads == 1 || options.arena || options.maxDepth == 0 || static_cast<size_t>(last - first) < 2 * minChunkSize || root == last || (*root != '[' && *root != '{')) return jsonFrom(first, last, options);
+
+        JsonSplitter splitter(root + 1, last, options, std::max(static_cast<size_t>(minChunkSize), static_cast<size_t>(last - first) / (threads * chunksPerThread)));
+        splitter.nodes.push_back(JsonSplitter::Node{ *root == '{', {} });
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; ++i) workers.emplace_back([&splitter] { splitter.parseChunks(); });
+        try
+        {
+            splitter.splitDocument();
+        }
+        catch (...) { splitter.failed = true; }
+        {
+            std::lock_guard<std::mutex> lock(splitter.mutex);
+            splitter.done = true;
+            splitter.found.notify_all();
+        }
+        splitter.parseChunks();
+        for (auto & worker : workers) worker.join();
+
+        // Report errors exactly as parsing on one thread would, since the scan and the chunks only find them in part, and out of order
+        if (splitter.failed) return jsonFrom(first, last, options);
+        JsonBuilder builder(first, last, options);
+        splitter.join(builder, 0);
+        return std::move(builder.values.back());
+    }
+
+    JsonValue jsonFromParallel(const std::string & text, const JsonParseOptions & options, unsigned threads) { return jsonFromParallel(text.data(), text.data() + text.size(), options, threads); }
+
+    // Writes the CBOR encoding of JsonValues, using the shortest form of each head, as RFC 8949 prefers
+    struct CborEncoder
+    {
+        std::vector<uint8_t> & out;
+
+        void put(uint8_t initial, uint64_t bits, int width) { out.push_back(initial); for (int i = width - 1; i >= 0; --i) out.push_back(static_cast<uint8_t>(bits >> (i * 8))); }
+        void head(int major, uint64_t n)
+        {
+            if (n < 24) out.push_back(static_cast<uint8_t>(major << 5 | n));
+            else if (n <= UINT8_MAX) put(static_cast<uint8_t>(major << 5 | 24), n, 1);
+            else if (n <= UINT16_MAX) put(static_cast<uint8_t>(major << 5 | 25), n, 2);
+            else if (n <= UINT32_MAX) put(static_cast<uint8_t>(major << 5 | 26), n, 4);
+            else put(static_cast<uint8_t>(major << 5 | 27), n, 8);
+        }
+        void integer(int64_t n) { if (n < 0) head(1, static_cast<uint64_t>(-1 - n)); else head(0, static_cast<uint64_t>(n)); }
+        void single(float n) { uint32_t bits; memcpy(&bits, &n, sizeof(bits)); put(0xFA, bits, 4); }
+        void real(double n) { uint64_t bits; memcpy(&bits, &n, sizeof(bits)); put(0xFB, bits, 8); }
+        void string(const char * first, size_t length) { head(3, length); out.insert(out.end(), first, first + length); }
+
+        void number(const JsonValue & num)
+        {
+            switch (num.cached)
+            {
+            case JsonValue::Integer: return integer(num.integer);
+            case JsonValue::Natural: return head(0, num.natural);
+            case JsonValue::Single: return single(static_cast<float>(num.real));
+            case JsonValue::Real: return real(num.real);
+            default:
+                // Keep integers exact where possible, as JsonValue::cacheNumber does
+                JsonDecimal d(num.chars(), num.chars() + num.digits);
+                if (d.integral && !d.truncated && d.exponent == 0 && (!d.negative || d.mantissa <= 1ULL << 63)) return d.negative && d.mantissa ? head(1, d.mantissa - 1) : head(0, d.mantissa);
+                double r;
+                num.numberAs(r);
+                return real(r);
+            }
+        }
+
+        void value(const JsonValue & val)
+        {
+            switch (val.kind)
+            {
+            case JsonValue::Null: return out.push_back(0xF6);
+            case JsonValue::False: return out.push_back(0xF4);
+            case JsonValue::True: return out.push_back(0xF5);
+            case JsonValue::String: return string(val.chars(), val.size);
+            case JsonValue::Number: return number(val);
+            case JsonValue::Array:
+                head(4, val.size);
+                for (auto n : val.packedIntegers()) integer(n);
+                for (auto n : val.packedReals()) real(n);
+                for (auto n : val.packedFloats()) single(n);
+                if (!val.cached) for (auto & elem : val.array()) value(elem);
+                return;
+            case JsonValue::Object:
+                head(5, val.size);
+                for (auto & kvp : val.object()) { string(kvp.first.data(), kvp.first.size()); value(kvp.second); }
+                return;
+            }
+        }
+    };
+
+    void CborWriter::write(const JsonValue & val) { CborEncoder{ bytes }.value(val); }
+    void CborWriter::writeString(const char * first, const char * last) { CborEncoder{ bytes }.string(first, last - first); }
+    void CborWriter::writeNumber(int64_t n) { CborEncoder{ bytes }.integer(n); }
+    void CborWriter::writeNumber(uint64_t n) { CborEncoder{ bytes }.head(0, n); }
+    void CborWriter::writeNumber(float n) { if (std::isfinite(n)) CborEncoder{ bytes }.single(n); else writeNull(); }
+    void CborWriter::writeNumber(double n) { if (std::isfinite(n)) CborEncoder{ bytes }.real(n); else writeNull(); }
+
+    std::vector<uint8_t> cborFrom(const JsonValue & val)
+    {
+        CborWriter writer;
+        writer.write(val);
+        return std::move(writer.bytes);
+    }
+
+    // Parser which reports CBOR data items to a JsonBuilder. Like JsonParser, it keeps open arrays and maps on an explicit stack rather than recursing.
+    struct CborParser
+    {
+        struct Frame { uint64_t remaining; bool object, indefinite; }; // Items left in an open array or map of definite length, or whether it ends with a break
+        const uint8_t * it, * last;
+        JsonBuilder & builder;
+        size_t maxDepth;
+        std::vector<Frame> stack;
+        std::string buffer; // Concatenated chunks of an indefinite length string
+
+        void require(uint64_t n) { if (static_cast<uint64_t>(last - it) < n) throw JsonParseError("Unexpected end of CBOR data"); }
+        bool matchAndDiscardBreak() { require(1); if (*it != 0xFF) return false; ++it; return true; }
+
+        uint64_t argument(int info) // Value following the initial byte, whose low five bits are info
+        {
+            if (info < 24) return static_cast<uint64_t>(info);
+            if (info > 27) throw JsonParseError("Invalid CBOR initial byte");
+            int width = 1 << (info - 24);
+            require(width);
+            uint64_t n = 0;
+            for (int i = 0; i < width; ++i) n = n << 8 | *it++;
+            return n;
+        }
+
+        const char * chars(uint64_t length) // Contents of a definite length text string, checked to be valid UTF-8
+        {
+            require(length);
+            auto first = reinterpret_cast<const char *>(it), last = first + length, c = first;
+            while (c != last) if (static_cast<uint8_t>(*c) < 0x80) ++c; else if (!(c = skipUtf8(c, last))) throw JsonParseError("invalid UTF-8 in string literal");
+            it += length;
+            return first;
+        }
+
+        template<class F> void parseString(int info, F onString) // Assumes the initial byte of a text string has already been consumed
+        {
+            if (info != 31)
+            {
+                auto length = argument(info);
+                auto first = chars(length);
+                return onString(first, first + length);
+            }
+            buffer.clear();
+            while (!matchAndDiscardBreak())
+            {
+                auto initial = *it++;
+                if (initial >> 5 != 3 || (initial & 31) == 31) throw JsonParseError("Invalid chunk of CBOR text string");
+                auto length = argument(initial & 31);
+                buffer.append(chars(length), length);
+            }
+            onString(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        static float half(uint16_t bits) // Decode an IEEE 754 half precision number, which floats hold exactly
+        {
+            int exponent = bits >> 10 & 0x1F, significand = bits & 0x3FF;
+            float magnitude = exponent == 0 ? std::ldexp(static_cast<float>(significand), -24) : exponent == 31 ? (significand ? NAN : INFINITY) : std::ldexp(static_cast<float>(significand + 1024), exponent - 25);
+            return bits >> 15 ? -magnitude : magnitude;
+        }
+
+        bool open(bool object, int info) // Start an array or map, and return whether it holds any items
+        {
+            if (stack.size() == maxDepth) throw JsonParseError("Exceeded maximum depth of nesting");
+            Frame frame = { 0, object, info == 31 };
+            if (frame.indefinite ? matchAndDiscardBreak() : (frame.remaining = argument(info)) == 0) return false;
+            if (!frame.indefinite) --frame.remaining;
+            stack.push_back(frame);
+            return true;
+        }
+
+        void parseKey()
+        {
+            require(1);
+            int major = *it >> 5, info = *it & 31;
+            ++it;
+            if (major != 3) throw JsonParseError("CBOR map keys must be text strings");
+            parseString(info, [this](const char * first, const char * last) { builder.onKey(first, last); });
+        }
+
+        void parseScalar(int major, int info)
+        {
+            switch (major)
+            {
+            case 0: { auto n = argument(info); if (n <= static_cast<uint64_t>(INT64_MAX)) builder.values.emplace_back(static_cast<int64_t>(n)); else builder.values.emplace_back(n); return; }
+            case 1: { auto n = argument(info); if (n <= static_cast<uint64_t>(INT64_MAX)) builder.values.emplace_back(-1 - static_cast<int64_t>(n)); else builder.values.emplace_back(-1.0 - static_cast<double>(n)); return; }
+            case 2: throw JsonParseError("CBOR byte strings are not supported");
+            case 3: return parseString(info, [this](const char * first, const char * last) { builder.onString(first, last); });
+            default:
+                switch (info)
+                {
+                case 20: return builder.onBool(false);
+                case 21: return builder.onBool(true);
+                case 22: case 23: return builder.onNull(); // Null and undefined
+                case 25: return builder.values.emplace_back(half(static_cast<uint16_t>(argument(info)))); // Infinities and NaNs become null
+                case 26: { auto bits = static_cast<uint32_t>(argument(info)); float n; memcpy(&n, &bits, sizeof(n)); return builder.values.emplace_back(n); }
+                case 27: { auto bits = argument(info); double n; memcpy(&n, &bits, sizeof(n)); return builder.values.emplace_back(n); }
+                case 31: throw JsonParseError("Unexpected CBOR break");
+                default: throw JsonParseError("Unsupported CBOR simple value");
+                }
+            }
+        }
+
+        void parseValue()
+        {
+            while (true)
+            {
+                // Report a data item, or the start of an array or map, whose first item is then parsed in turn
+                require(1);
+                int major = *it >> 5, info = *it & 31;
+                ++it;
+                if (major == 6) { argument(info); continue; } // Tags add meaning which JSON cannot express, so only their content is kept
+                if (major == 4)
+                {
+                    builder.onStartArray();
+                    if (open(false, info)) continue;
+                    builder.onEndArray();
+                }
+                else if (major == 5)
+                {
+                    builder.onStartObject();
+                    if (open(true, info)) { parseKey(); continue; }
+                    builder.onEndObject();
+                }
+                else parseScalar(major, info);
+
+                // Report the end of any arrays and maps which are complete, then move on to the next item of the innermost one left
+                while (true)
+                {
+                    if (stack.empty()) return;
+                    auto & frame = stack.back();
+                    if (frame.indefinite ? !matchAndDiscardBreak() : frame.remaining != 0)
+                    {
+                        if (!frame.indefinite) --frame.remaining;
+                        if (frame.object) parseKey();
+                        break;
+                    }
+                    if (frame.object) builder.onEndObject(); else builder.onEndArray();
+                    stack.pop_back();
+                }
+            }
+        }
+    };
+
+    JsonValue jsonFromCbor(const uint8_t * first, const uint8_t * last, const JsonParseOptions & options)
+    {
+        JsonBuilder builder(reinterpret_cast<const char *>(first), reinterpret_cast<const char *>(last), options);
+        CborParser p{ first, last, builder, options.maxDepth, {}, {} };
+        p.parseValue();
+        if (p.it != last) throw JsonParseError("Expected end of CBOR data");
+        return std::move(builder.values.back());
+    }
+
+    JsonValue jsonFromCbor(const std::vector<uint8_t> & data, const JsonParseOptions & options) { return jsonFromCbor(data.data(), data.data() + data.size(), options); }
 }
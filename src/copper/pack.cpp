@@ -40,19 +40,22 @@ namespace cu
     JsonValue PackedField::readJson(const void * structBuffer) const
     {
         JsonArray arr;
+        arr.reserve(dimensions.z);
         for (uint3 index; index.z<dimensions.z; ++index.z)
         {
             JsonArray mat;
+            mat.reserve(dimensions.y);
             for (index.y = 0; index.y<dimensions.y; ++index.y)
             {
                 JsonArray col;
+                col.reserve(dimensions.x);
                 for (index.x = 0; index.x<dimensions.x; ++index.x)
                 {
                     col.push_back(jsonFromPacked(reinterpret_cast<const int8_t *>(structBuffer) + offset + dot(index, stride), baseType));
                 }
-                mat.push_back(flatten(col));
+                mat.push_back(flatten(std::move(col)));
             }
-            arr.push_back(flatten(mat));
+            arr.push_back(flatten(std::move(mat)));
         }
         return flatten(arr);
     }
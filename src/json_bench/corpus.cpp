@@ -0,0 +1,86 @@
+#include "corpus.h"
+#include <cu/json.h>
+
+using namespace cu;
+
+// Small xorshift generator, used instead of <random> whose distributions differ between standard libraries
+struct Random
+{
+    uint64_t state;
+
+    uint64_t next() { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; }
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+    double between(double lo, double hi) { return lo + (hi - lo) * (next() >> 11) * (1.0 / (1ULL << 53)); }
+};
+
+static std::string sentence(Random & rand, size_t words, bool escaped, bool unicode)
+{
+    static const char * ascii[] = { "mesh", "vertex", "light", "shadow", "camera", "the", "of", "and", "texture", "normal", "scene", "render" };
+    static const char * utf8[] = { "\xC3\xA9t\xC3\xA9", "gr\xC3\xB6\xC3\x9F" "e", "\xE6\x97\xA5\xE6\x9C\xAC", "\xD0\xBC\xD0\xB8\xD1\x80", "\xF0\x9F\x99\x82", "na\xC3\xAFve" };
+    std::string s;
+    for (size_t i = 0; i < words; ++i)
+    {
+        if (i) s += escaped && rand.below(16) == 0 ? (rand.below(2) ? "\n" : "\"") : " ";
+        s += unicode && rand.below(4) == 0 ? utf8[rand.below(6)] : ascii[rand.below(12)];
+    }
+    return s;
+}
+
+// Objects of a scene, with names, poses, flags, and small meshes
+static JsonValue sceneObject(Random & rand, size_t i)
+{
+    JsonArray verts, tris;
+    for (int j = 0; j < 8; ++j) verts.push_back(JsonObject{ { "pos", JsonArray{ rand.between(-1, 1), rand.between(-1, 1) } }, { "col", JsonArray{ rand.between(0, 1), rand.between(0, 1), rand.between(0, 1) } } });
+    for (int j = 0; j < 6; ++j) tris.push_back(JsonArray{ static_cast<int64_t>(rand.below(8)), static_cast<int64_t>(rand.below(8)), static_cast<int64_t>(rand.below(8)) });
+    return JsonObject{
+        { "name", "object_" + std::to_string(i) },
+        { "tag", sentence(rand, 3, i % 10 == 0, false) },
+        { "pose", JsonObject{ { "position", JsonArray{ rand.between(-100, 100), rand.between(-100, 100), rand.between(-100, 100) } }, { "orientation", JsonArray{ rand.between(-1, 1), rand.between(-1, 1), rand.between(-1, 1), rand.between(-1, 1) } } } },
+        { "visible", i % 3 == 0 },
+        { "parent", i % 5 ? JsonValue() : JsonValue(static_cast<int64_t>(i) - 1) },
+        { "mesh", JsonObject{ { "verts", JsonArray(move(verts)) }, { "tris", JsonArray(move(tris)) } } }
+    };
+}
+
+// Records made mostly of long string literals, some with escape sequences and some in non-ASCII text
+static JsonValue textRecord(Random & rand, size_t i)
+{
+    return JsonObject{
+        { "id", static_cast<int64_t>(i) },
+        { "title", sentence(rand, 4 + rand.below(8), false, true) },
+        { "body", sentence(rand, 40 + rand.below(400), i % 4 == 0, i % 3 == 0) }
+    };
+}
+
+static JsonValue numberRow(Random & rand, size_t i)
+{
+    JsonArray row;
+    for (int j = 0; j < 16; ++j) row.push_back(j % 4 ? JsonValue(rand.between(-1e3, 1e3)) : JsonValue(static_cast<int64_t>(rand.below(1 << 20)) - static_cast<int64_t>(i)));
+    return row;
+}
+
+// Text of an Array of items, generated one at a time until it reaches roughly the given size, laid out as JsonWriter would lay out the whole Array
+template<class F> static std::string generate(size_t bytes, int tabWidth, F item)
+{
+    Random rand = { 0x9E3779B97F4A7C15ULL };
+    std::string text = "[";
+    for (size_t i = 0; text.size() < bytes; ++i)
+    {
+        JsonWriter writer;
+        if (tabWidth) writer.write(tabbed(item(rand, i), tabWidth, tabWidth)); else writer.write(item(rand, i));
+        if (i) text += ',';
+        if (tabWidth) text += "\n" + std::string(tabWidth, ' ');
+        text += writer.str();
+    }
+    return text + (tabWidth ? "\n]" : "]");
+}
+
+std::vector<CorpusDocument> generateCorpus(size_t bytes)
+{
+    return{
+        { "scene", generate(bytes, 0, sceneObject) },
+        { "scene-indented", generate(bytes, 4, sceneObject) },
+        { "text", generate(bytes, 0, textRecord) },
+        { "numbers", generate(bytes, 0, numberRow) }
+    };
+}
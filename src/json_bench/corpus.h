@@ -0,0 +1,13 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <string>
+#include <vector>
+
+struct CorpusDocument { std::string name, text; };
+
+// Generate the same JSON documents on every run and platform, each of roughly the given size, which between them exercise each part of the parser's
+// character scanning: compact and indented structure, plain and escaped strings, non-ASCII UTF-8 text, and numbers
+std::vector<CorpusDocument> generateCorpus(size_t bytes);
+
+#endif
@@ -0,0 +1,112 @@
+// Measures the throughput and peak memory use of parsing JSON documents. Usage: json_bench [-write directory] [file...]
+// Without files, parses a generated corpus, which -write saves to the given directory instead. Peak memory is that of the whole process, so pass a single
+// file to measure it exactly. Build with -mavx2, or with -DCOPPER_JSON_NO_SIMD, to compare the parser's vectorized character scanning with its scalar loops.
+#include "corpus.h"
+#include <cu/json.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace cu;
+
+static double peakMegabytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1e6;
+#else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1e6; // Reported in bytes
+#else
+    return usage.ru_maxrss / 1e3; // Reported in kilobytes
+#endif
+#endif
+}
+
+static std::string readFile(const char * path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error(std::string("cannot read ") + path);
+    in.seekg(0, std::ios::end);
+    std::string text(static_cast<size_t>(in.tellg()), 0);
+    in.seekg(0, std::ios::beg);
+    in.read(&text[0], text.size());
+    return text;
+}
+
+// Best time of several runs, in seconds
+template<class F> static double bestTime(F f)
+{
+    double best = 1e9;
+    for (int i = 0; i < 5; ++i)
+    {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count());
+    }
+    return best;
+}
+
+static void bench(const std::string & name, const std::string & text)
+{
+    auto before = peakMegabytes();
+    { auto doc = jsonFrom(text); } // First parse, whose memory use is measured, also checks that the document is valid
+    auto peak = peakMegabytes();
+    JsonHandler handler; // Ignores every event, so that only scanning is measured
+    auto sax = bestTime([&]() { jsonParse(text, handler); }), dom = bestTime([&]() { jsonFrom(text); });
+    printf("%-24s %8.1f MB  SAX %6.0f MB/s  DOM %6.0f MB/s  peak RSS %8.1f MB (+%.1f MB while parsing)\n", name.c_str(), text.size() / 1e6, text.size() / sax / 1e6, text.size() / dom / 1e6, peak, peak - before);
+}
+
+int main(int argc, char * argv[])
+{
+    try
+    {
+#if defined(COPPER_JSON_NO_SIMD)
+        std::cout << "Character scanning: scalar" << std::endl;
+#elif defined(__AVX2__)
+        std::cout << "Character scanning: AVX2" << std::endl;
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        std::cout << "Character scanning: SSE2" << std::endl;
+#else
+        std::cout << "Character scanning: scalar" << std::endl;
+#endif
+        std::string directory;
+        int files = 0;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (argv[i] == std::string("-write") && i + 1 < argc) directory = argv[++i];
+            else bench(argv[i], readFile(argv[i])), ++files;
+        }
+        if (files) return 0;
+
+        for (auto & doc : generateCorpus(32 << 20))
+        {
+            if (directory.empty()) { bench(doc.name, doc.text); continue; }
+            auto path = directory + "/" + doc.name + ".json";
+            std::ofstream out(path, std::ios::binary);
+            if (!out.write(doc.text.data(), doc.text.size())) throw std::runtime_error("cannot write " + path);
+            std::cout << "Wrote " << path << std::endl;
+        }
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
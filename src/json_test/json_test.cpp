@@ -0,0 +1,134 @@
+// Checks behaviour of JsonValues and the reflection module which the other programs do not exercise. Usage: json_test. Returns 1 if any check fails.
+#include <cu/refl.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace cu;
+
+// A type serialized by its own overloads, and a reflected type with fields of it, which the generic templates must leave to those overloads
+struct Color { float r, g, b; };
+static JsonValue toJson(const Color & c) { return JsonArray{ c.r, c.g, c.b }; }
+static void fromJson(Color & c, const JsonValue & val) { c = { val[0].number<float>(), val[1].number<float>(), val[2].number<float>() }; }
+struct Lamp { std::string name; Color color; std::vector<Color> filters; };
+template<class F> void visit_fields(Lamp & o, F f) { f("name", o.name); f("color", o.color); f("filters", o.filters); }
+static bool operator == (const Color & a, const Color & b) { return a.r == b.r && a.g == b.g && a.b == b.b; }
+static bool operator == (const Lamp & a, const Lamp & b) { return a.name == b.name && a.color == b.color && a.filters == b.filters; }
+
+static int failures = 0;
+
+static void check(bool passed, const std::string & what)
+{
+    if (passed) return;
+    std::cout << "FAILED: " << what << std::endl;
+    ++failures;
+}
+
+template<class T> static std::string format(T n) { char buffer[32]; return std::string(buffer, formatJsonNumber(buffer, n)); }
+template<class T, class Bits> static T fromBits(Bits bits) { T n; memcpy(&n, &bits, sizeof(n)); return n; }
+
+// Shortest round trip text of numbers whose digits are hard to find, as printed by reference implementations. Of two equally short texts, the one closer to
+// the number is expected, and of two equally close, the one ending in an even digit.
+static void checkShortestNumbers()
+{
+    static const struct { uint64_t bits; const char * text; } doubles[] = {
+        { 0x2977103AC45829D4ULL, "6.137688561080735e-109" }, { 0x6148A5503E26BB79ULL, "4.331216019728802e+160" }, { 0xDFA19A60254A3D5EULL, "-4.609727332255617e+152" },
+        { 0x2E62529787495566ULL, "2.947398922780633e-85" }, { 0x675A73AB440D3B32ULL, "7.366022521794322e+189" }, { 0x808B617662A876F9ULL, "-4.873928638715819e-306" },
+        { 0x63B048763E700487ULL, "1.573161854299726e+172" }, { 0x9129B9873BC12640ULL, "-5.429551004193493e-226" }, { 0x96590C3A427CA91AULL, "-5.112953786469353e-201" },
+        { 0x2552DB2C06527AA4ULL, "6.80071649123332e-129" }, { 0x0D34DC5F5180920AULL, "4.773699867354701e-245" }, { 0xAEAD54461E73FD24ULL, "-7.548685997843105e-84" },
+        { 0x4359B6DD16114F92ULL, "28951740368109130" }, { 0xF8B8260173969072ULL, "-3.265919786902787e+273" }, { 0xC365C84F6ACDFEDEULL, "-49049743446243060" },
+        { 0x431DE9719C80CBE9ULL, "2104862122717946.2" }, { 0xE8BEBE340376D731ULL, "-3.5907334647606913e+196" }, { 0x4303D35388DD239AULL, "697547536180339.2" },
+        { 0xC316A6AA39A1E865ULL, "-1593924882299417.2" }, { 0xA461CD25FE4AEF82ULL, "-1.9593189396422452e-133" }, { 0xC31D5A81A4EEDD91ULL, "-2065571797251940.2" },
+        { 0x3FA74927913E8146ULL, "0.04548000000000001" }, { 0x44B52D02C7E14AF6ULL, "1e+23" }, { 0x4340000000000000ULL, "9007199254740992" },
+        { 0x7FEFFFFFFFFFFFFFULL, "1.7976931348623157e+308" }, { 0x0010000000000000ULL, "2.2250738585072014e-308" }, { 0x0000000000000001ULL, "5e-324" },
+    };
+    static const struct { uint32_t bits; const char * text; } floats[] = {
+        { 0xCCB3F12A, "-94341460" }, { 0x4C1935CE, "40163130" }, { 0xCE6ABEF8, "-984596000" }, { 0x4A30F3FB, "2899198.8" }, { 0x4A7D66F5, "4151741.2" },
+        { 0xCA371F79, "-3000286.2" }, { 0x7F7FFFFF, "3.4028235e+38" }, { 0x00000001, "1e-45" },
+    };
+    for (auto & d : doubles) check(format(fromBits<double>(d.bits)) == d.text, "double is written as " + format(fromBits<double>(d.bits)) + " rather than " + d.text);
+    for (auto & f : floats) check(format(fromBits<float>(f.bits)) == f.text, "float is written as " + format(fromBits<float>(f.bits)) + " rather than " + f.text);
+
+    // Every other double must read back exactly, and the closest number of one fewer significant digit, as printed by the C library, must not
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 100000; ++i)
+    {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        auto n = fromBits<double>(state);
+        if (!std::isfinite(n) || n == 0) continue;
+        auto text = format(n);
+        auto mantissa = text.substr(text[0] == '-', text.find('e') - (text[0] == '-'));
+        mantissa.erase(std::remove(mantissa.begin(), mantissa.end(), '.'), mantissa.end());
+        mantissa.erase(0, mantissa.find_first_not_of('0'));
+        mantissa.erase(mantissa.find_last_not_of('0') + 1);
+        char shorter[32];
+        snprintf(shorter, sizeof(shorter), "%.*e", static_cast<int>(mantissa.size()) - 2, n);
+        check(jsonFrom(text).number<double>() == n, text + " does not read back as the double it was written from");
+        check(mantissa.size() == 1 || strtod(shorter, nullptr) != n, text + " is not the shortest text of its double, " + shorter + " is shorter");
+    }
+}
+
+static void checkCustomOverloads()
+{
+    const Lamp lamp = { "desk", { 1, 0.5f, 0 }, { { 0, 0, 1 }, { 0.25f, 0.25f, 0.25f } } };
+    const std::string text = "{\"name\":\"desk\",\"color\":[1,0.5,0],\"filters\":[[0,0,1],[0.25,0.25,0.25]]}";
+    Color color;
+    fromJson(color, jsonFrom("[1,0,0]"));
+    check(color == Color{ 1, 0, 0 }, "Color read from a temporary JsonValue differs");
+    Lamp fromValue, fromTemporary;
+    fromJson(fromValue, static_cast<const JsonValue &>(jsonFrom(text)));
+    fromJson(fromTemporary, jsonFrom(text));
+    check(fromValue == lamp, "Lamp read from a JsonValue differs");
+    check(fromTemporary == lamp, "Lamp read from a temporary JsonValue differs");
+    check(toJson(lamp) == jsonFrom(text), "toJson(Lamp) differs");
+    check(encodeJson(lamp) == text, "Lamp encoded as text differs");
+    check(decodeJson<Lamp>(text) == lamp, "Lamp decoded from text differs");
+    check(decodeCbor<Lamp>(encodeCbor(lamp)) == lamp, "Lamp differs after a round trip through CBOR");
+}
+
+// Copies taken while references returned by edit() and push() are still held must not see changes made through them afterwards
+static void checkEditedCopies()
+{
+    JsonValue root = jsonFrom("{\"x\":1,\"y\":[1,2,3],\"z\":{\"a\":[true]}}");
+    auto & x = root.edit("x");
+    JsonValue first = root;
+    x = 2;
+    auto & y0 = root.edit("y").edit(0);
+    JsonValue second = root;
+    y0 = "changed";
+    auto & pushed = root.edit("z").edit("a").push(false);
+    JsonValue third;
+    third = root;
+    pushed = nullptr;
+    check(first == jsonFrom("{\"x\":1,\"y\":[1,2,3],\"z\":{\"a\":[true]}}"), "a copy of a value changed with an edit of one of its members");
+    check(second == jsonFrom("{\"x\":2,\"y\":[1,2,3],\"z\":{\"a\":[true]}}"), "a copy of a value changed with an edit at depth");
+    check(third == jsonFrom("{\"x\":2,\"y\":[\"changed\",2,3],\"z\":{\"a\":[true,false]}}"), "a value assigned from another changed with a pushed element");
+    check(root == jsonFrom("{\"x\":2,\"y\":[\"changed\",2,3],\"z\":{\"a\":[true,null]}}"), "an edited value did not change");
+
+    JsonValue wide = JsonObject{};
+    for (int i = 0; i < 100; ++i) wide.set("key" + std::to_string(i), i);
+    auto & last = wide.edit("key99");
+    JsonValue copy = wide;
+    last = -1;
+    check(copy["key99"] == JsonValue(99) && copy["key0"] == JsonValue(0), "a copy of a wide edited Object changed with it or lost its members");
+}
+
+int main()
+{
+    try
+    {
+        checkShortestNumbers();
+        checkCustomOverloads();
+        checkEditedCopies();
+    }
+    catch (const std::exception & e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << (failures ? "JSON tests FAILED" : "JSON tests passed") << std::endl;
+    return failures ? 1 : 0;
+}